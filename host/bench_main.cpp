@@ -0,0 +1,39 @@
+// Runs the micro-benchmarks in dishwasher_benchmark.h on the host.
+//
+// Usage: dishwasher_bench [--iterations N]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+
+#include "dishwasher_benchmark.h"
+#include "dishwasher_manager.h"
+
+int main(int argc, char **argv)
+{
+    uint32_t iterations = 100000;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc)
+        {
+            iterations = strtoul(argv[++i], NULL, 10);
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [--iterations N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    esp_log_level_set("*", ESP_LOG_WARN);
+
+    ESP_ERROR_CHECK(DishwasherMgr().Init());
+
+    RunDishwasherBenchmarks(iterations);
+
+    return 0;
+}
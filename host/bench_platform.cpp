@@ -0,0 +1,90 @@
+#include "dishwasher_benchmark.h"
+
+#include <malloc.h>
+
+#include <chrono>
+
+// Ticks are nanoseconds on the host.
+//
+// Allocations are counted by interposing malloc and friends, which also sees
+// operator new. This relies on glibc's __libc_* entry points.
+//
+
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+extern "C" void __libc_free(void *ptr);
+
+static uint64_t sAllocationCount = 0;
+static int64_t sAllocatedBytes = 0;
+
+extern "C" void *malloc(size_t size)
+{
+    void *ptr = __libc_malloc(size);
+
+    if (ptr != nullptr)
+    {
+        sAllocationCount++;
+        sAllocatedBytes += malloc_usable_size(ptr);
+    }
+
+    return ptr;
+}
+
+extern "C" void *calloc(size_t count, size_t size)
+{
+    void *ptr = __libc_calloc(count, size);
+
+    if (ptr != nullptr)
+    {
+        sAllocationCount++;
+        sAllocatedBytes += malloc_usable_size(ptr);
+    }
+
+    return ptr;
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+    int64_t old_size = ptr != nullptr ? malloc_usable_size(ptr) : 0;
+    void *new_ptr = __libc_realloc(ptr, size);
+
+    if (new_ptr != nullptr)
+    {
+        sAllocationCount++;
+        sAllocatedBytes += (int64_t)malloc_usable_size(new_ptr) - old_size;
+    }
+
+    return new_ptr;
+}
+
+extern "C" void free(void *ptr)
+{
+    if (ptr != nullptr)
+    {
+        sAllocatedBytes -= malloc_usable_size(ptr);
+    }
+
+    __libc_free(ptr);
+}
+
+uint32_t BenchmarkGetTicks()
+{
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+}
+
+uint32_t BenchmarkGetTicksPerMicrosecond()
+{
+    return 1000;
+}
+
+uint64_t BenchmarkGetAllocationCount()
+{
+    return sAllocationCount;
+}
+
+int64_t BenchmarkGetAllocatedBytes()
+{
+    return sAllocatedBytes;
+}
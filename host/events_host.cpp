@@ -0,0 +1,84 @@
+#include "dishwasher_events.h"
+
+#include "dishwasher_manager.h"
+#include "host_backends.h"
+
+// There is only one thread on the host, so events are handled as soon as they
+// are posted. Events posted while one is being handled (from a timer, or a
+// Matter backend) queue up behind it, the same order the device would see.
+//
+
+static constexpr uint32_t kEventQueueLength = 32;
+
+static DishwasherEvent sEvents[kEventQueueLength];
+static uint32_t sHead = 0;
+static uint32_t sCount = 0;
+static bool sIsDispatching = false;
+static uint32_t sDroppedEvents = 0;
+static HostEventStats sHostEvents;
+
+HostEventStats &HostEvents()
+{
+    return sHostEvents;
+}
+
+// Each manager calls this from its Init, so it must leave the queue alone: a
+// manager can be set up while another's events are queued, as in the fleet.
+// The queue is static and starts empty, so there is nothing to set up.
+//
+esp_err_t DishwasherEventsInit()
+{
+    return ESP_OK;
+}
+
+bool DishwasherPostEvent(DishwasherManager &manager, DishwasherEventType type, uint32_t value)
+{
+    if (sCount == kEventQueueLength)
+    {
+        sDroppedEvents++;
+        return false;
+    }
+
+    sEvents[(sHead + sCount) % kEventQueueLength] = {type, value, &manager};
+    sCount++;
+
+    if (sIsDispatching)
+    {
+        return true;
+    }
+
+    sIsDispatching = true;
+
+    do
+    {
+        DishwasherManager *to_finish = nullptr;
+
+        while (sCount > 0)
+        {
+            DishwasherEvent event = sEvents[sHead];
+
+            sHead = (sHead + 1) % kEventQueueLength;
+            sCount--;
+
+            event.manager->ScheduleFinish(to_finish);
+            event.manager->HandleEvent(event);
+            sHostEvents.handled++;
+        }
+
+        DishwasherManager::FinishScheduled(to_finish);
+    } while (sCount > 0);
+
+    sIsDispatching = false;
+
+    return true;
+}
+
+bool DishwasherPostEvent(DishwasherEventType type, uint32_t value)
+{
+    return DishwasherPostEvent(DishwasherMgr(), type, value);
+}
+
+uint32_t DishwasherGetDroppedEvents()
+{
+    return sDroppedEvents;
+}
@@ -0,0 +1,208 @@
+// Runs a fleet of independent DishwasherManagers side by side on one virtual
+// clock and dispatcher, the way a controller or energy manager would see a
+// house (or a street) full of them.
+//
+// Usage: dishwasher_fleet [--appliances N] [--cycles N] [--adjust-start S] [--energy-pause S] [--verbose]
+//
+//   --appliances N    number of dishwashers (default 100)
+//   --cycles N        programs each dishwasher runs, all started together (default 10)
+//   --adjust-start S  move each start S seconds into the future, plus a minute
+//                     per dishwasher, the way a StartTimeAdjustRequest would
+//                     (default 600, 0 to leave the starts alone)
+//   --energy-pause S  pause each running program for S seconds, the way a
+//                     PauseRequest would (default 300, 0 for no pauses)
+//   --verbose         show the firmware's log output
+//
+// Every dishwasher is opted into energy management and runs headless. The
+// DeviceEnergyManagementDelegate needs the Matter SDK, so the requests are
+// posted as the events it would post.
+//
+
+#include <chrono>
+#include <malloc.h>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "esp_log.h"
+
+#include "dishwasher_manager.h"
+#include "host_backends.h"
+#include "virtual_clock.h"
+#include "wash_programs.h"
+
+using chip::app::Clusters::OperationalState::OperationalStateEnum;
+
+struct FleetOptions
+{
+    uint32_t appliances = 100;
+    uint32_t cycles = 10;
+    uint32_t adjustStart = 600;
+    uint32_t energyPause = 300;
+    bool verbose = false;
+};
+
+struct Appliance
+{
+    char checkpointKey[16];
+    std::unique_ptr<DishwasherManager> manager;
+    bool hasRun;
+    bool isPaused;
+};
+
+static bool ParseOptions(int argc, char **argv, FleetOptions &options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        bool has_value = i + 1 < argc;
+
+        if (strcmp(argv[i], "--appliances") == 0 && has_value)
+        {
+            options.appliances = strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--cycles") == 0 && has_value)
+        {
+            options.cycles = strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--adjust-start") == 0 && has_value)
+        {
+            options.adjustStart = strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--energy-pause") == 0 && has_value)
+        {
+            options.energyPause = strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--verbose") == 0)
+        {
+            options.verbose = true;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return options.appliances > 0;
+}
+
+int main(int argc, char **argv)
+{
+    FleetOptions options;
+
+    if (!ParseOptions(argc, argv, options))
+    {
+        fprintf(stderr, "usage: %s [--appliances N] [--cycles N] [--adjust-start S] [--energy-pause S] [--verbose]\n", argv[0]);
+        return 1;
+    }
+
+    esp_log_level_set("*", options.verbose ? ESP_LOG_VERBOSE : ESP_LOG_WARN);
+
+    // Heap in use before and after bringing the fleet up gives the cost of one
+    // dishwasher, including its timers, on top of the object itself.
+    //
+    size_t heap_before = mallinfo2().uordblks;
+
+    std::vector<Appliance> fleet(options.appliances);
+
+    for (uint32_t i = 0; i < options.appliances; i++)
+    {
+        Appliance &appliance = fleet[i];
+
+        snprintf(appliance.checkpointKey, sizeof(appliance.checkpointKey), "program%u", (unsigned)i);
+        appliance.manager.reset(new DishwasherManager({
+            .checkpointKey = appliance.checkpointKey,
+            .hasFrontPanel = false,
+        }));
+
+        ESP_ERROR_CHECK(appliance.manager->Init());
+
+        // The energy management menu is toggled with the rotary encoder.
+        //
+        DishwasherManager &dishwasher = *appliance.manager;
+
+        DishwasherPostEvent(dishwasher, DishwasherEventType::kSetPower, true);
+        DishwasherPostEvent(dishwasher, DishwasherEventType::kWheelClicked);
+        DishwasherPostEvent(dishwasher, DishwasherEventType::kEncoderNext);
+        DishwasherPostEvent(dishwasher, DishwasherEventType::kWheelClicked);
+    }
+
+    size_t heap_after = mallinfo2().uordblks;
+
+    uint64_t failures = 0;
+    uint64_t energy_pauses = 0;
+    uint64_t events_before = HostEvents().handled;
+    auto wall_start = std::chrono::steady_clock::now();
+
+    for (uint32_t cycle = 0; cycle < options.cycles; cycle++)
+    {
+        for (uint32_t i = 0; i < options.appliances; i++)
+        {
+            Appliance &appliance = fleet[i];
+            DishwasherManager &dishwasher = *appliance.manager;
+
+            appliance.hasRun = false;
+            appliance.isPaused = options.energyPause == 0;
+
+            DishwasherPostEvent(dishwasher, DishwasherEventType::kChangeMode, (i + cycle) % kWashProgramCount);
+            DishwasherPostEvent(dishwasher, DishwasherEventType::kStartProgram);
+
+            if (options.adjustStart > 0)
+            {
+                DishwasherPostEvent(dishwasher, DishwasherEventType::kAdjustStartTime, MatterGetEpochTime() + options.adjustStart + i * 60);
+            }
+        }
+
+        // Run every timer until all the programs have finished and nothing is armed.
+        //
+        do
+        {
+            for (Appliance &appliance : fleet)
+            {
+                DishwasherManager &dishwasher = *appliance.manager;
+
+                if (dishwasher.GetOperationalState() != OperationalStateEnum::kRunning)
+                {
+                    continue;
+                }
+
+                appliance.hasRun = true;
+
+                if (!appliance.isPaused)
+                {
+                    DishwasherPostEvent(dishwasher, DishwasherEventType::kEnergyPause, options.energyPause);
+                    appliance.isPaused = true;
+                    energy_pauses++;
+                }
+            }
+        } while (VirtualClockRunNext());
+
+        for (uint32_t i = 0; i < options.appliances; i++)
+        {
+            if (!fleet[i].hasRun || fleet[i].manager->GetOperationalState() != OperationalStateEnum::kStopped)
+            {
+                fprintf(stderr, "dishwasher %u did not complete cycle %u\n", (unsigned)i, (unsigned)cycle);
+                failures++;
+            }
+        }
+    }
+
+    double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+    uint64_t events = HostEvents().handled - events_before;
+    uint64_t programs = (uint64_t)options.appliances * options.cycles;
+
+    printf("appliances              %u\n", (unsigned)options.appliances);
+    printf("programs                %llu (%llu failed)\n", (unsigned long long)programs, (unsigned long long)failures);
+    printf("simulated time          %.1f h\n", VirtualClockGetTime() / 3.6e9);
+    printf("wall time               %.3f s\n", wall_s);
+    printf("manager size            %u bytes\n", (unsigned)sizeof(DishwasherManager));
+    printf("heap per appliance      %.0f bytes\n", (double)(heap_after - heap_before) / options.appliances);
+    printf("events handled          %llu (%lu dropped)\n", (unsigned long long)events, DishwasherGetDroppedEvents());
+    printf("events per second       %.0f\n", wall_s > 0 ? events / wall_s : 0.0);
+    printf("energy manager pauses   %llu\n", (unsigned long long)energy_pauses);
+    printf("matter publishes        %llu\n", (unsigned long long)HostMatter().publishes);
+    printf("nvs checkpoint writes   %llu (%.1f per program)\n", (unsigned long long)HostNvs().writes, programs > 0 ? (double)HostNvs().writes / programs : 0.0);
+
+    return failures == 0 ? 0 : 1;
+}
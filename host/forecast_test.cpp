@@ -0,0 +1,66 @@
+// Checks how a ModifyForecastRequest's slot adjustments are turned into
+// adjustments of the forecast plan.
+//
+// Usage: forecast_test
+//
+// Prints each check and exits non-zero if any fails.
+//
+
+#include <stdio.h>
+
+#include "forecast_builder.h"
+#include "wash_programs.h"
+
+static unsigned sFailures = 0;
+
+static void Check(bool condition, const char *description)
+{
+    printf("%s  %s\n", condition ? "ok    " : "FAILED", description);
+
+    if (!condition)
+    {
+        sFailures++;
+    }
+}
+
+static ForecastSlotAdjustment MakeSlotAdjustment(const ForecastPlan &plan, uint8_t slotIndex)
+{
+    ForecastSlotAdjustment slot = {};
+
+    slot.slotIndex = slotIndex;
+    slot.duration = plan.slots[slotIndex].defaultDuration;
+
+    return slot;
+}
+
+static void CheckRepeatedSlots()
+{
+    ForecastPlan plan;
+    BuildForecast(GetWashProgram(0), 1760000000, plan);
+    plan.slotResolution = 0;
+
+    ForecastAdjustment published;
+    ForecastAdjustment adjustment;
+
+    published.forecastId = plan.forecastId;
+    published.slots[published.count++] = MakeSlotAdjustment(plan, 0);
+    published.slots[published.count++] = MakeSlotAdjustment(plan, 1);
+
+    Check(!HasRepeatedForecastSlot(published), "different slots are not repeats");
+    Check(CollapseForecastAdjustment(plan, published, adjustment), "different slots are collapsed");
+    Check(adjustment.count == 2, "each slot is adjusted once");
+
+    published.slots[published.count++] = MakeSlotAdjustment(plan, 0);
+
+    Check(HasRepeatedForecastSlot(published), "a slot named twice is a repeat");
+    Check(!CollapseForecastAdjustment(plan, published, adjustment), "a slot named twice is not collapsed");
+}
+
+int main()
+{
+    CheckRepeatedSlots();
+
+    printf("%u failed\n", sFailures);
+
+    return sFailures > 0 ? 1 : 0;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "dishwasher_matter.h"
+
+// What the host Matter backend has been told by DishwasherManager.
+//
+// The attribute values mirror what a controller would read back, and the
+// counters show how much work each change would have caused on the device.
+//
+struct HostMatterState
+{
+    chip::app::Clusters::OperationalState::OperationalStateEnum operationalState = chip::app::Clusters::OperationalState::OperationalStateEnum::kStopped;
+    uint8_t currentPhase = 0;
+    uint8_t currentMode = 0;
+    bool onOff = false;
+    bool optedIn = false;
+    ForecastPlan forecast;
+    PowerAdjustPlan powerAdjustment;
+    EnergyState energyState = EnergyState::kOnline;
+
+    // Each publish is one ScheduleWork hop to the Matter thread on the device.
+    //
+    uint64_t publishes = 0;
+
+    uint64_t operationalStateUpdates = 0;
+    uint64_t currentPhaseUpdates = 0;
+    uint64_t countdownTimeUpdates = 0;
+    uint64_t currentModeUpdates = 0;
+    uint64_t onOffUpdates = 0;
+    uint64_t optOutStateUpdates = 0;
+    uint64_t forecastUpdates = 0;
+    uint64_t powerAdjustmentUpdates = 0;
+    uint64_t energyStateUpdates = 0;
+};
+
+HostMatterState &HostMatter();
+
+// The wall clock time reported when the virtual clock reads zero.
+//
+constexpr uint32_t kHostEpochBase = 1760000000;
+
+// What the real StatusDisplay has asked of the LVGL stand-in in stubs/lvgl.h.
+//
+// An invalidation is a change to a visible object, which LVGL would redraw and
+// flush to the panel on the device.
+//
+struct HostLvglStats
+{
+    uint64_t calls = 0;
+    uint64_t labelTextSets = 0;
+    uint64_t invalidations = 0;
+};
+
+HostLvglStats &HostLvgl();
+
+// What has been written to the in-memory NVS in nvs_host.cpp.
+//
+struct HostNvsStats
+{
+    uint64_t reads = 0;
+    uint64_t writes = 0;
+    uint64_t bytesWritten = 0;
+};
+
+HostNvsStats &HostNvs();
+
+// What the host dispatcher in events_host.cpp has handled, across every
+// DishwasherManager.
+//
+struct HostEventStats
+{
+    uint64_t handled = 0;
+};
+
+HostEventStats &HostEvents();
@@ -0,0 +1,250 @@
+#include "lvgl.h"
+
+#include <string.h>
+
+#include <memory>
+#include <vector>
+
+#include "driver/i2c_master.h"
+#include "esp_lcd_panel_ops.h"
+#include "esp_lcd_panel_vendor.h"
+#include "esp_lvgl_port.h"
+
+#include "host_backends.h"
+
+// Copied label text lives inside the object, so that the stand-in itself never
+// allocates after Init and the allocation counts belong to the caller. Static
+// text is referenced, as LVGL does.
+//
+struct _lv_obj_t
+{
+    const char *text;
+    char buffer[64];
+    uint32_t flags;
+};
+
+static HostLvglStats sHostLvgl;
+
+static std::vector<std::unique_ptr<lv_obj_t>> sObjects;
+static lv_obj_t sScreen;
+
+static lv_disp_drv_t sDisplayDriver;
+static lv_disp_t sDisplay = {&sDisplayDriver};
+
+HostLvglStats &HostLvgl()
+{
+    return sHostLvgl;
+}
+
+static bool IsVisible(const lv_obj_t *obj)
+{
+    return (obj->flags & LV_OBJ_FLAG_HIDDEN) == 0;
+}
+
+// LVGL marks an object's area for redrawing whenever a visible object changes.
+//
+static void Invalidate(const lv_obj_t *obj)
+{
+    if (IsVisible(obj))
+    {
+        sHostLvgl.invalidations++;
+    }
+}
+
+lv_obj_t *lv_scr_act(void)
+{
+    return &sScreen;
+}
+
+lv_obj_t *lv_label_create(lv_obj_t *parent)
+{
+    sObjects.emplace_back(new lv_obj_t{"", "", 0});
+    return sObjects.back().get();
+}
+
+void lv_label_set_text(lv_obj_t *obj, const char *text)
+{
+    sHostLvgl.calls++;
+    sHostLvgl.labelTextSets++;
+
+    if (text != NULL && text != obj->buffer)
+    {
+        strncpy(obj->buffer, text, sizeof(obj->buffer) - 1);
+        obj->buffer[sizeof(obj->buffer) - 1] = '\0';
+    }
+
+    obj->text = obj->buffer;
+
+    Invalidate(obj);
+}
+
+void lv_label_set_text_static(lv_obj_t *obj, const char *text)
+{
+    sHostLvgl.calls++;
+    sHostLvgl.labelTextSets++;
+
+    if (text != NULL)
+    {
+        obj->text = text;
+    }
+
+    Invalidate(obj);
+}
+
+const char *lv_label_get_text(const lv_obj_t *obj)
+{
+    return obj->text;
+}
+
+void lv_obj_set_width(lv_obj_t *obj, lv_coord_t w)
+{
+    sHostLvgl.calls++;
+    Invalidate(obj);
+}
+
+void lv_obj_align(lv_obj_t *obj, lv_align_t align, lv_coord_t x_ofs, lv_coord_t y_ofs)
+{
+    sHostLvgl.calls++;
+    Invalidate(obj);
+}
+
+void lv_obj_add_flag(lv_obj_t *obj, lv_obj_flag_t f)
+{
+    sHostLvgl.calls++;
+
+    // Hiding invalidates the area the object covered.
+    //
+    if (f & LV_OBJ_FLAG_HIDDEN)
+    {
+        Invalidate(obj);
+    }
+
+    obj->flags |= f;
+}
+
+void lv_obj_clear_flag(lv_obj_t *obj, lv_obj_flag_t f)
+{
+    sHostLvgl.calls++;
+
+    obj->flags &= ~f;
+
+    if (f & LV_OBJ_FLAG_HIDDEN)
+    {
+        Invalidate(obj);
+    }
+}
+
+bool lv_obj_has_flag(const lv_obj_t *obj, lv_obj_flag_t f)
+{
+    return (obj->flags & f) == f;
+}
+
+void lv_obj_set_style_bg_color(lv_obj_t *obj, lv_color_t value, lv_style_selector_t selector)
+{
+    sHostLvgl.calls++;
+    Invalidate(obj);
+}
+
+void lv_obj_set_style_bg_opa(lv_obj_t *obj, lv_opa_t value, lv_style_selector_t selector)
+{
+    sHostLvgl.calls++;
+    Invalidate(obj);
+}
+
+void lv_obj_set_style_text_color(lv_obj_t *obj, lv_color_t value, lv_style_selector_t selector)
+{
+    sHostLvgl.calls++;
+    Invalidate(obj);
+}
+
+void lv_obj_set_style_text_align(lv_obj_t *obj, lv_text_align_t value, lv_style_selector_t selector)
+{
+    sHostLvgl.calls++;
+    Invalidate(obj);
+}
+
+lv_color_t lv_color_hex(uint32_t c)
+{
+    return lv_color_t{(uint8_t)(c != 0)};
+}
+
+void lv_disp_set_rotation(lv_disp_t *disp, lv_disp_rot_t rotation)
+{
+}
+
+void lv_disp_flush_ready(lv_disp_drv_t *disp_drv)
+{
+}
+
+esp_err_t lvgl_port_init(const lvgl_port_cfg_t *cfg)
+{
+    return ESP_OK;
+}
+
+lv_disp_t *lvgl_port_add_disp(const lvgl_port_display_cfg_t *disp_cfg)
+{
+    sDisplayDriver.hor_res = disp_cfg->hres;
+    sDisplayDriver.ver_res = disp_cfg->vres;
+
+    return &sDisplay;
+}
+
+bool lvgl_port_lock(uint32_t timeout_ms)
+{
+    return true;
+}
+
+void lvgl_port_unlock(void)
+{
+}
+
+esp_err_t lvgl_port_stop(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t lvgl_port_resume(void)
+{
+    return ESP_OK;
+}
+
+// The panel and bus only need handles that are not NULL.
+//
+
+esp_err_t i2c_new_master_bus(const i2c_master_bus_config_t *bus_config, i2c_master_bus_handle_t *ret_bus_handle)
+{
+    *ret_bus_handle = (i2c_master_bus_handle_t)&sDisplay;
+    return ESP_OK;
+}
+
+esp_err_t esp_lcd_new_panel_io_i2c(i2c_master_bus_handle_t bus, const esp_lcd_panel_io_i2c_config_t *io_config, esp_lcd_panel_io_handle_t *ret_io)
+{
+    *ret_io = (esp_lcd_panel_io_handle_t)&sDisplay;
+    return ESP_OK;
+}
+
+esp_err_t esp_lcd_new_panel_ssd1306(esp_lcd_panel_io_handle_t io, const esp_lcd_panel_dev_config_t *panel_dev_config, esp_lcd_panel_handle_t *ret_panel)
+{
+    *ret_panel = (esp_lcd_panel_handle_t)&sDisplay;
+    return ESP_OK;
+}
+
+esp_err_t esp_lcd_panel_reset(esp_lcd_panel_handle_t panel)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_lcd_panel_init(esp_lcd_panel_handle_t panel)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_lcd_panel_disp_on_off(esp_lcd_panel_handle_t panel, bool on_off)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_lcd_panel_draw_bitmap(esp_lcd_panel_handle_t panel, int x_start, int y_start, int x_end, int y_end, const void *color_data)
+{
+    return ESP_OK;
+}
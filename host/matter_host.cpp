@@ -0,0 +1,83 @@
+#include "host_backends.h"
+
+#include "esp_timer.h"
+
+static HostMatterState sHostMatter;
+
+HostMatterState &HostMatter()
+{
+    return sHostMatter;
+}
+
+// Changes are applied straight away, there is no Matter thread to hand them to.
+// Every manager publishes to the same state, so with more than one (see
+// fleet_main.cpp) it holds whichever published last.
+//
+bool MatterPublishChanges(DishwasherManager &manager, const MatterChangeSet &changes)
+{
+    sHostMatter.publishes++;
+
+    if (changes.dirty & MatterChangeSet::kOperationalState)
+    {
+        sHostMatter.operationalState = changes.operationalState;
+        sHostMatter.operationalStateUpdates++;
+    }
+
+    if (changes.dirty & MatterChangeSet::kCurrentPhase)
+    {
+        sHostMatter.currentPhase = changes.currentPhase;
+        sHostMatter.currentPhaseUpdates++;
+    }
+
+    if (changes.dirty & MatterChangeSet::kCountdownTime)
+    {
+        sHostMatter.countdownTimeUpdates++;
+    }
+
+    if (changes.dirty & MatterChangeSet::kCurrentMode)
+    {
+        sHostMatter.currentMode = changes.currentMode;
+        sHostMatter.currentModeUpdates++;
+    }
+
+    if (changes.dirty & MatterChangeSet::kOnOff)
+    {
+        sHostMatter.onOff = changes.onOff;
+        sHostMatter.onOffUpdates++;
+    }
+
+    if (changes.dirty & MatterChangeSet::kOptOutState)
+    {
+        sHostMatter.optedIn = changes.optedIn;
+        sHostMatter.optOutStateUpdates++;
+    }
+
+    if (changes.dirty & MatterChangeSet::kForecast)
+    {
+        sHostMatter.forecast = changes.forecast;
+        sHostMatter.forecastUpdates++;
+    }
+
+    if (changes.dirty & MatterChangeSet::kPowerAdjustment)
+    {
+        sHostMatter.powerAdjustmentUpdates++;
+        sHostMatter.powerAdjustment = changes.powerAdjustment;
+    }
+
+    if (changes.dirty & MatterChangeSet::kEnergyState)
+    {
+        sHostMatter.energyState = changes.energyState;
+        sHostMatter.energyStateUpdates++;
+    }
+
+    return true;
+}
+
+void MatterFactoryReset()
+{
+}
+
+uint32_t MatterGetEpochTime()
+{
+    return kHostEpochBase + (uint32_t)(esp_timer_get_time() / 1000000);
+}
@@ -0,0 +1,19 @@
+#include "mode_selector.h"
+
+// The rotary encoder is driven directly through DishwasherManager in the simulator.
+//
+
+ModeSelector ModeSelector::sModeSelector;
+
+esp_err_t ModeSelector::Init()
+{
+    return ESP_OK;
+}
+
+void ModeSelector::Suspend()
+{
+}
+
+void ModeSelector::Resume()
+{
+}
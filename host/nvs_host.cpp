@@ -0,0 +1,70 @@
+#include "host_backends.h"
+
+#include "nvs.h"
+
+#include <string.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+// Entries are keyed by namespace and key, and live in memory for the life of
+// the process.
+//
+static std::vector<std::string> sNamespaces;
+static std::map<std::string, std::vector<uint8_t>> sEntries;
+static HostNvsStats sHostNvs;
+
+HostNvsStats &HostNvs()
+{
+    return sHostNvs;
+}
+
+esp_err_t nvs_open(const char *namespace_name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    sNamespaces.push_back(namespace_name);
+    *out_handle = (nvs_handle_t)sNamespaces.size();
+
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    auto entry = sEntries.find(sNamespaces[handle - 1] + "/" + key);
+
+    if (entry == sEntries.end())
+    {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+
+    if (*length < entry->second.size())
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    memcpy(out_value, entry->second.data(), entry->second.size());
+    *length = entry->second.size();
+    sHostNvs.reads++;
+
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    const uint8_t *bytes = (const uint8_t *)value;
+
+    sEntries[sNamespaces[handle - 1] + "/" + key].assign(bytes, bytes + length);
+    sHostNvs.writes++;
+    sHostNvs.bytesWritten += length;
+
+    return ESP_OK;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+}
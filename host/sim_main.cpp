@@ -0,0 +1,314 @@
+// Runs wash cycles through the real DishwasherManager on a virtual clock.
+//
+// Usage: dishwasher_sim [--cycles N] [--mode M] [--opt-in] [--adjust-start S] [--tariff] [--shave-peaks] [--power-cap W] [--energy-pause S] [--verbose]
+//
+//   --cycles N        number of programs to run back to back (default 1000)
+//   --mode M          program to run; by default every program is used in turn
+//   --opt-in          opt into energy management, which delays the start
+//   --adjust-start S  when opted in, move the start S seconds into the future
+//                     the way a StartTimeAdjustRequest would
+//   --tariff          when opted in, give each cycle a day of prices with a
+//                     cheap overnight period to schedule against
+//   --shave-peaks     as each program starts, run every step at its minimum
+//                     power for longer, the way a ModifyForecastRequest would
+//   --power-cap W     once each program is running, cap it at W watts until it
+//                     ends, the way a PowerAdjustRequest would
+//   --energy-pause S  pause each program for S seconds in its first pausable
+//                     step, the way a PauseRequest would
+//   --verbose         show the firmware's log output
+//
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+
+#include "dishwasher_manager.h"
+#include "host_backends.h"
+#include "power_manager.h"
+#include "virtual_clock.h"
+#include "wash_programs.h"
+
+using chip::app::Clusters::OperationalState::OperationalStateEnum;
+
+struct SimOptions
+{
+    uint32_t cycles = 1000;
+    int mode = -1;
+    bool optIn = false;
+    uint32_t adjustStart = 0;
+    bool tariff = false;
+    bool shavePeaks = false;
+    uint32_t powerCap = 0;
+    uint32_t energyPause = 0;
+    bool verbose = false;
+};
+
+// A day in 15 minute buckets: dear in the evening peak, cheapest from 4 hours
+// ahead until 8 hours ahead.
+//
+static TariffCurve MakeDayTariff(uint32_t startTime)
+{
+    TariffCurve tariff;
+
+    tariff.startTime = startTime;
+    tariff.bucketDuration = 15 * 60;
+    tariff.bucketCount = kMaxTariffBuckets;
+
+    for (uint8_t i = 0; i < kMaxTariffBuckets; i++)
+    {
+        uint8_t hour = i / 4;
+
+        if (hour >= 4 && hour < 8)
+        {
+            tariff.costs[i] = 10;
+        }
+        else if (hour >= 16 && hour < 20)
+        {
+            tariff.costs[i] = 40;
+        }
+        else
+        {
+            tariff.costs[i] = 25;
+        }
+    }
+
+    return tariff;
+}
+
+// Every slot of the published forecast at its lowest power and longest duration.
+//
+static ForecastAdjustment MakePeakShavingAdjustment(const ForecastPlan &forecast)
+{
+    ForecastAdjustment adjustment;
+
+    adjustment.forecastId = forecast.forecastId;
+    adjustment.reason = ForecastReason::kGridOptimization;
+
+    for (uint8_t i = 0; i < forecast.slotCount; i++)
+    {
+        for (uint8_t part = 0; part < GetForecastSlotParts(forecast, i); part++)
+        {
+            ForecastPlanSlot slot = GetForecastSlotPart(forecast, i, part);
+
+            adjustment.slots[adjustment.count] = {adjustment.count, slot.maxDuration, true, slot.minPower};
+            adjustment.count++;
+        }
+    }
+
+    return adjustment;
+}
+
+static bool ParseOptions(int argc, char **argv, SimOptions &options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        bool has_value = i + 1 < argc;
+
+        if (strcmp(argv[i], "--cycles") == 0 && has_value)
+        {
+            options.cycles = strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--mode") == 0 && has_value)
+        {
+            options.mode = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--opt-in") == 0)
+        {
+            options.optIn = true;
+        }
+        else if (strcmp(argv[i], "--adjust-start") == 0 && has_value)
+        {
+            options.adjustStart = strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--tariff") == 0)
+        {
+            options.tariff = true;
+        }
+        else if (strcmp(argv[i], "--shave-peaks") == 0)
+        {
+            options.shavePeaks = true;
+        }
+        else if (strcmp(argv[i], "--power-cap") == 0 && has_value)
+        {
+            options.powerCap = strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--energy-pause") == 0 && has_value)
+        {
+            options.energyPause = strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--verbose") == 0)
+        {
+            options.verbose = true;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return options.mode < kWashProgramCount;
+}
+
+int main(int argc, char **argv)
+{
+    SimOptions options;
+
+    if (!ParseOptions(argc, argv, options))
+    {
+        fprintf(stderr, "usage: %s [--cycles N] [--mode M] [--opt-in] [--adjust-start S] [--tariff] [--shave-peaks] [--power-cap W] [--energy-pause S] [--verbose]\n", argv[0]);
+        return 1;
+    }
+
+    esp_log_level_set("*", options.verbose ? ESP_LOG_VERBOSE : ESP_LOG_WARN);
+
+    DishwasherManager &dishwasher = DishwasherMgr();
+
+    ESP_ERROR_CHECK(dishwasher.Init());
+
+    // Everything goes through the event queue, as the buttons, encoder and Matter would on the device.
+    //
+    DishwasherPostEvent(DishwasherEventType::kSetPower, true);
+
+    if (options.optIn)
+    {
+        // The energy management menu is toggled with the rotary encoder.
+        //
+        DishwasherPostEvent(DishwasherEventType::kWheelClicked);
+        DishwasherPostEvent(DishwasherEventType::kEncoderNext);
+        DishwasherPostEvent(DishwasherEventType::kWheelClicked);
+    }
+
+    uint64_t failures = 0;
+    uint64_t energy_pauses = 0;
+    uint64_t published_slots = 0;
+    size_t max_forecast_size = 0;
+    double start_delay_s = 0;
+    double program_s = 0;
+    auto wall_start = std::chrono::steady_clock::now();
+
+    for (uint32_t cycle = 0; cycle < options.cycles; cycle++)
+    {
+        uint8_t mode = options.mode >= 0 ? options.mode : cycle % kWashProgramCount;
+        uint64_t cycle_start = VirtualClockGetTime();
+
+        DishwasherPostEvent(DishwasherEventType::kChangeMode, mode);
+
+        if (options.tariff)
+        {
+            dishwasher.PostTariff(MakeDayTariff(MatterGetEpochTime()));
+        }
+
+        DishwasherPostEvent(DishwasherEventType::kStartProgram);
+
+        if (options.optIn && options.adjustStart > 0)
+        {
+            DishwasherPostEvent(DishwasherEventType::kAdjustStartTime, MatterGetEpochTime() + options.adjustStart);
+        }
+
+        published_slots += GetPublishedSlotCount(HostMatter().forecast);
+
+        if (EstimateForecastSize(HostMatter().forecast) > max_forecast_size)
+        {
+            max_forecast_size = EstimateForecastSize(HostMatter().forecast);
+        }
+
+        if (options.shavePeaks)
+        {
+            dishwasher.PostForecastAdjustment(MakePeakShavingAdjustment(HostMatter().forecast));
+        }
+
+        start_delay_s += (double)HostMatter().forecast.startTime - kHostEpochBase - cycle_start / 1e6;
+
+        // Run every timer until the program has finished and nothing is armed,
+        // timing the program from when it starts running to when it stops.
+        //
+        bool is_capped = options.powerCap == 0;
+        bool is_paused = options.energyPause == 0;
+        uint64_t run_start = 0;
+        uint64_t run_end = 0;
+
+        do
+        {
+            OperationalStateEnum state = dishwasher.GetOperationalState();
+
+            if (state == OperationalStateEnum::kRunning && run_start == 0)
+            {
+                run_start = VirtualClockGetTime();
+            }
+            else if (state == OperationalStateEnum::kStopped && run_start != 0 && run_end == 0)
+            {
+                run_end = VirtualClockGetTime();
+            }
+
+            if (state == OperationalStateEnum::kRunning && !is_capped)
+            {
+                dishwasher.PostPowerCap({Watts(options.powerCap), dishwasher.GetTimeRemaining(), ForecastReason::kGridOptimization});
+                is_capped = true;
+            }
+
+            // The cluster server only lets a pausable slot be paused.
+            //
+            const ForecastPlan &forecast = HostMatter().forecast;
+
+            if (state == OperationalStateEnum::kRunning && !is_paused && forecast.hasActiveSlot && forecast.slots[forecast.activeSlotNumber].isPausable)
+            {
+                DishwasherPostEvent(DishwasherEventType::kEnergyPause, options.energyPause);
+                energy_pauses++;
+                is_paused = true;
+            }
+        } while (VirtualClockRunNext());
+
+        program_s += (run_end - run_start) / 1e6;
+
+        uint64_t expected_us = (uint64_t)GetWashProgram(mode).GetDuration() * 1000000;
+        uint64_t elapsed_us = VirtualClockGetTime() - cycle_start;
+
+        if (dishwasher.GetOperationalState() != OperationalStateEnum::kStopped || elapsed_us < expected_us)
+        {
+            fprintf(stderr, "cycle %u (%s) did not complete correctly\n", cycle, GetWashProgram(mode).label);
+            failures++;
+        }
+    }
+
+    double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+
+    uint64_t program_timer_fires = VirtualClockGetFireCount("program");
+    uint64_t display_refresh_fires = VirtualClockGetFireCount("display_refresh");
+    uint64_t callbacks = program_timer_fires + display_refresh_fires;
+    HostMatterState &matter = HostMatter();
+
+    printf("cycles                  %u (%llu failed)\n", options.cycles, (unsigned long long)failures);
+    printf("simulated time          %.1f h\n", VirtualClockGetTime() / 3.6e9);
+    printf("wall time               %.3f s\n", wall_s);
+    printf("cycles per second       %.0f\n", options.cycles / wall_s);
+    printf("program timer wakeups   %llu\n", (unsigned long long)program_timer_fires);
+    printf("display refreshes       %llu\n", (unsigned long long)display_refresh_fires);
+    printf("cost per timer callback %.0f ns\n", callbacks > 0 ? wall_s * 1e9 / callbacks : 0.0);
+    printf("lvgl calls              %llu\n", (unsigned long long)HostLvgl().calls);
+    printf("lvgl invalidations      %llu\n", (unsigned long long)HostLvgl().invalidations);
+    printf("matter publishes        %llu\n", (unsigned long long)matter.publishes);
+    printf("matter state updates    %llu\n", (unsigned long long)matter.operationalStateUpdates);
+    printf("matter phase updates    %llu\n", (unsigned long long)matter.currentPhaseUpdates);
+    printf("matter countdown reports %llu (%lu suppressed)\n", (unsigned long long)matter.countdownTimeUpdates, DishwasherMgr().GetCountdownSuppressedCount());
+    printf("matter forecast updates %llu\n", (unsigned long long)matter.forecastUpdates);
+    printf("matter power adjustment updates %llu\n", (unsigned long long)matter.powerAdjustmentUpdates);
+    printf("matter esa state updates %llu\n", (unsigned long long)matter.energyStateUpdates);
+    printf("energy manager pauses   %llu\n", (unsigned long long)energy_pauses);
+    printf("mean start delay        %.1f min\n", options.cycles > 0 ? start_delay_s / options.cycles / 60.0 : 0.0);
+    printf("mean forecast slots     %.1f (largest %u bytes)\n", options.cycles > 0 ? (double)published_slots / options.cycles : 0.0, (unsigned)max_forecast_size);
+    printf("mean program length     %.1f min\n", options.cycles > 0 ? program_s / options.cycles / 60.0 : 0.0);
+    printf("nvs checkpoint writes   %llu (%.1f per cycle)\n", (unsigned long long)HostNvs().writes, options.cycles > 0 ? (double)HostNvs().writes / options.cycles : 0.0);
+
+    for (uint8_t i = 0; i < kPowerStateCount; i++)
+    {
+        PowerState state = (PowerState)i;
+        double share = 100.0 * PowerMgr().GetTimeInState(state) / (VirtualClockGetTime() / 1000.0);
+
+        printf("time %-18s %.1f %%\n", PowerManager::GetStateName(state), share);
+    }
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+// Host stand-in for the Matter SDK OperationalState server header, providing
+// only the enum DishwasherManager exposes in its public API.
+//
+
+#include <stdint.h>
+
+#include <type_traits>
+
+namespace chip
+{
+    template <typename T>
+    constexpr std::underlying_type_t<T> to_underlying(T e)
+    {
+        return static_cast<std::underlying_type_t<T>>(e);
+    }
+
+    namespace app
+    {
+        namespace Clusters
+        {
+            namespace OperationalState
+            {
+                enum class OperationalStateEnum : uint8_t
+                {
+                    kStopped = 0x00,
+                    kRunning = 0x01,
+                    kPaused = 0x02,
+                    kError = 0x03,
+                };
+            } // namespace OperationalState
+        } // namespace Clusters
+    } // namespace app
+} // namespace chip
@@ -0,0 +1,6 @@
+#pragma once
+
+// Host stand-in for the ESP-IDF GPIO driver header.
+//
+
+typedef int gpio_num_t;
@@ -0,0 +1,32 @@
+#pragma once
+
+// Host stand-in for the ESP-IDF I2C master driver header.
+//
+
+#include <stdint.h>
+
+#include "driver/gpio.h"
+#include "esp_err.h"
+#include "esp_lcd_panel_io.h"
+
+typedef int i2c_port_num_t;
+
+typedef enum
+{
+    I2C_CLK_SRC_DEFAULT,
+} i2c_clock_source_t;
+
+typedef struct
+{
+    i2c_port_num_t i2c_port;
+    gpio_num_t sda_io_num;
+    gpio_num_t scl_io_num;
+    i2c_clock_source_t clk_source;
+    uint8_t glitch_ignore_cnt;
+    struct
+    {
+        uint32_t enable_internal_pullup : 1;
+    } flags;
+} i2c_master_bus_config_t;
+
+esp_err_t i2c_new_master_bus(const i2c_master_bus_config_t *bus_config, i2c_master_bus_handle_t *ret_bus_handle);
@@ -0,0 +1,31 @@
+#pragma once
+
+// Host stand-in for the ESP-IDF LCD panel IO header.
+//
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+typedef struct esp_lcd_panel_io_t *esp_lcd_panel_io_handle_t;
+typedef struct esp_lcd_panel_t *esp_lcd_panel_handle_t;
+typedef struct i2c_master_bus_t *i2c_master_bus_handle_t;
+
+typedef struct
+{
+    uint32_t dev_addr;
+    size_t control_phase_bytes;
+    unsigned int dc_bit_offset;
+    int lcd_cmd_bits;
+    int lcd_param_bits;
+    uint32_t scl_speed_hz;
+} esp_lcd_panel_io_i2c_config_t;
+
+esp_err_t esp_lcd_new_panel_io_i2c(i2c_master_bus_handle_t bus, const esp_lcd_panel_io_i2c_config_t *io_config, esp_lcd_panel_io_handle_t *ret_io);
+
+typedef struct
+{
+    int reset_gpio_num;
+    uint32_t bits_per_pixel;
+    void *vendor_config;
+} esp_lcd_panel_dev_config_t;
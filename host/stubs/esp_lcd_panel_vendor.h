@@ -0,0 +1,13 @@
+#pragma once
+
+// Host stand-in for the ESP-IDF LCD vendor panel header (SSD1306 only).
+//
+
+#include "esp_lcd_panel_io.h"
+
+typedef struct
+{
+    uint8_t height;
+} esp_lcd_panel_ssd1306_config_t;
+
+esp_err_t esp_lcd_new_panel_ssd1306(esp_lcd_panel_io_handle_t io, const esp_lcd_panel_dev_config_t *panel_dev_config, esp_lcd_panel_handle_t *ret_panel);
@@ -0,0 +1,35 @@
+#include "esp_log.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+
+static esp_log_level_t sLogLevel = ESP_LOG_WARN;
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    // Tags are not tracked individually on the host.
+    //
+    sLogLevel = level;
+}
+
+esp_log_level_t esp_log_level_get(const char *tag)
+{
+    return sLogLevel;
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    if (level > sLogLevel)
+    {
+        return;
+    }
+
+    static const char kLevelLetters[] = {'N', 'E', 'W', 'I', 'D', 'V'};
+
+    fprintf(stderr, "%c (%s) ", kLevelLetters[level], tag);
+
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+// Host stand-in for esp_lvgl_port. There is no LVGL task on the host; the
+// display created here is what lv_scr_act() draws on.
+//
+
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_lcd_panel_io.h"
+#include "lvgl.h"
+
+typedef struct
+{
+    int task_priority;
+} lvgl_port_cfg_t;
+
+#define ESP_LVGL_PORT_INIT_CONFIG() \
+    {                               \
+        .task_priority = 4,         \
+    }
+
+typedef struct
+{
+    esp_lcd_panel_io_handle_t io_handle;
+    esp_lcd_panel_handle_t panel_handle;
+    uint32_t buffer_size;
+    bool double_buffer;
+    uint32_t hres;
+    uint32_t vres;
+    bool monochrome;
+    struct
+    {
+        bool swap_xy;
+        bool mirror_x;
+        bool mirror_y;
+    } rotation;
+} lvgl_port_display_cfg_t;
+
+esp_err_t lvgl_port_init(const lvgl_port_cfg_t *cfg);
+lv_disp_t *lvgl_port_add_disp(const lvgl_port_display_cfg_t *disp_cfg);
+bool lvgl_port_lock(uint32_t timeout_ms);
+void lvgl_port_unlock(void);
+esp_err_t lvgl_port_stop(void);
+esp_err_t lvgl_port_resume(void);
@@ -0,0 +1,52 @@
+#include "esp_pm.h"
+
+#include <memory>
+#include <vector>
+
+struct esp_pm_lock
+{
+    esp_pm_lock_type_t type;
+    const char *name;
+    int count;
+};
+
+static std::vector<std::unique_ptr<esp_pm_lock>> sLocks;
+
+esp_err_t esp_pm_configure(const void *config)
+{
+    return config != nullptr ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_pm_lock_create(esp_pm_lock_type_t lock_type, int arg, const char *name, esp_pm_lock_handle_t *out_handle)
+{
+    if (out_handle == nullptr)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    sLocks.emplace_back(new esp_pm_lock{lock_type, name, 0});
+    *out_handle = sLocks.back().get();
+
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t handle)
+{
+    handle->count++;
+
+    return ESP_OK;
+}
+
+// As in ESP-IDF, releasing a lock more times than it was taken is an error.
+//
+esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t handle)
+{
+    if (handle->count == 0)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    handle->count--;
+
+    return ESP_OK;
+}
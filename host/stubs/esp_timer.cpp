@@ -0,0 +1,194 @@
+#include "esp_timer.h"
+
+#include <string.h>
+
+#include <memory>
+#include <vector>
+
+#include "virtual_clock.h"
+
+struct esp_timer
+{
+    esp_timer_create_args_t args;
+    uint64_t deadlineUs;
+    uint64_t periodUs;
+    bool isArmed;
+    uint64_t fireCount;
+};
+
+static uint64_t sNowUs = 0;
+static std::vector<std::unique_ptr<esp_timer>> sTimers;
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args, esp_timer_handle_t *out_handle)
+{
+    if (create_args == nullptr || create_args->callback == nullptr || out_handle == nullptr)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    sTimers.emplace_back(new esp_timer{*create_args, 0, 0, false, 0});
+    *out_handle = sTimers.back().get();
+
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    if (timer->isArmed)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    timer->deadlineUs = sNowUs + timeout_us;
+    timer->periodUs = 0;
+    timer->isArmed = true;
+
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period)
+{
+    if (timer->isArmed)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    timer->deadlineUs = sNowUs + period;
+    timer->periodUs = period;
+    timer->isArmed = true;
+
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    if (!timer->isArmed)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    timer->isArmed = false;
+
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    for (auto it = sTimers.begin(); it != sTimers.end(); ++it)
+    {
+        if (it->get() == timer)
+        {
+            sTimers.erase(it);
+            return ESP_OK;
+        }
+    }
+
+    return ESP_ERR_INVALID_ARG;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer)
+{
+    return timer->isArmed;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return (int64_t)sNowUs;
+}
+
+static esp_timer *FindNextTimer()
+{
+    esp_timer *next = nullptr;
+
+    for (auto &timer : sTimers)
+    {
+        if (timer->isArmed && (next == nullptr || timer->deadlineUs < next->deadlineUs))
+        {
+            next = timer.get();
+        }
+    }
+
+    return next;
+}
+
+bool VirtualClockRunNext()
+{
+    esp_timer *timer = FindNextTimer();
+
+    if (timer == nullptr)
+    {
+        return false;
+    }
+
+    if (timer->deadlineUs > sNowUs)
+    {
+        sNowUs = timer->deadlineUs;
+    }
+
+    // Rearm before the callback, so that the callback can stop or restart it.
+    //
+    if (timer->periodUs > 0)
+    {
+        timer->deadlineUs += timer->periodUs;
+    }
+    else
+    {
+        timer->isArmed = false;
+    }
+
+    timer->fireCount++;
+    timer->args.callback(timer->args.arg);
+
+    return true;
+}
+
+void VirtualClockAdvanceTo(uint64_t timeUs)
+{
+    while (VirtualClockNextDeadline() <= timeUs)
+    {
+        VirtualClockRunNext();
+    }
+
+    if (timeUs > sNowUs)
+    {
+        sNowUs = timeUs;
+    }
+}
+
+uint64_t VirtualClockNextDeadline()
+{
+    esp_timer *timer = FindNextTimer();
+
+    return timer != nullptr ? timer->deadlineUs : UINT64_MAX;
+}
+
+uint64_t VirtualClockGetTime()
+{
+    return sNowUs;
+}
+
+uint64_t VirtualClockGetFireCount(const char *name)
+{
+    uint64_t count = 0;
+
+    for (auto &timer : sTimers)
+    {
+        if (timer->args.name != nullptr && strcmp(timer->args.name, name) == 0)
+        {
+            count += timer->fireCount;
+        }
+    }
+
+    return count;
+}
+
+void VirtualClockReset()
+{
+    for (auto &timer : sTimers)
+    {
+        timer->isArmed = false;
+        timer->fireCount = 0;
+    }
+
+    sNowUs = 0;
+}
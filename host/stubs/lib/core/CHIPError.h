@@ -0,0 +1,5 @@
+#pragma once
+
+// Host stand-in for the Matter SDK CHIPError.h. Nothing that the simulator
+// builds uses CHIP_ERROR, but dishwasher_manager.h includes this header.
+//
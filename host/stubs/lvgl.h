@@ -0,0 +1,112 @@
+#pragma once
+
+// Host stand-in for LVGL 8.3, just large enough to run the real StatusDisplay.
+//
+// Objects only keep the state that decides what LVGL would redraw: their text
+// and whether they are hidden. Every call that would invalidate a visible
+// object on the device is counted in HostLvgl() (see host_backends.h), which
+// stands in for the rendering and flushing work the device would do.
+//
+
+#include <stdint.h>
+
+typedef struct _lv_obj_t lv_obj_t;
+
+typedef int16_t lv_coord_t;
+
+typedef struct
+{
+    uint8_t full;
+} lv_color_t;
+
+typedef struct
+{
+    lv_coord_t x1;
+    lv_coord_t y1;
+    lv_coord_t x2;
+    lv_coord_t y2;
+} lv_area_t;
+
+typedef struct _lv_disp_drv_t
+{
+    lv_coord_t hor_res;
+    lv_coord_t ver_res;
+    void (*flush_cb)(struct _lv_disp_drv_t *disp_drv, const lv_area_t *area, lv_color_t *color_p);
+} lv_disp_drv_t;
+
+typedef struct _lv_disp_t
+{
+    lv_disp_drv_t *driver;
+} lv_disp_t;
+
+typedef uint8_t lv_opa_t;
+typedef uint32_t lv_obj_flag_t;
+typedef uint32_t lv_style_selector_t;
+
+enum
+{
+    LV_OBJ_FLAG_HIDDEN = (1 << 0),
+};
+
+enum
+{
+    LV_PART_MAIN = 0,
+};
+
+enum
+{
+    LV_OPA_TRANSP = 0,
+    LV_OPA_COVER = 255,
+};
+
+typedef enum
+{
+    LV_ALIGN_DEFAULT = 0,
+    LV_ALIGN_TOP_LEFT,
+    LV_ALIGN_TOP_MID,
+    LV_ALIGN_TOP_RIGHT,
+    LV_ALIGN_BOTTOM_LEFT,
+    LV_ALIGN_BOTTOM_MID,
+    LV_ALIGN_BOTTOM_RIGHT,
+    LV_ALIGN_LEFT_MID,
+    LV_ALIGN_RIGHT_MID,
+    LV_ALIGN_CENTER,
+} lv_align_t;
+
+typedef enum
+{
+    LV_TEXT_ALIGN_AUTO,
+    LV_TEXT_ALIGN_LEFT,
+    LV_TEXT_ALIGN_CENTER,
+    LV_TEXT_ALIGN_RIGHT,
+} lv_text_align_t;
+
+typedef enum
+{
+    LV_DISP_ROT_NONE = 0,
+    LV_DISP_ROT_90,
+    LV_DISP_ROT_180,
+    LV_DISP_ROT_270,
+} lv_disp_rot_t;
+
+lv_obj_t *lv_scr_act(void);
+lv_obj_t *lv_label_create(lv_obj_t *parent);
+void lv_label_set_text(lv_obj_t *obj, const char *text);
+void lv_label_set_text_static(lv_obj_t *obj, const char *text);
+const char *lv_label_get_text(const lv_obj_t *obj);
+
+void lv_obj_set_width(lv_obj_t *obj, lv_coord_t w);
+void lv_obj_align(lv_obj_t *obj, lv_align_t align, lv_coord_t x_ofs, lv_coord_t y_ofs);
+void lv_obj_add_flag(lv_obj_t *obj, lv_obj_flag_t f);
+void lv_obj_clear_flag(lv_obj_t *obj, lv_obj_flag_t f);
+bool lv_obj_has_flag(const lv_obj_t *obj, lv_obj_flag_t f);
+
+void lv_obj_set_style_bg_color(lv_obj_t *obj, lv_color_t value, lv_style_selector_t selector);
+void lv_obj_set_style_bg_opa(lv_obj_t *obj, lv_opa_t value, lv_style_selector_t selector);
+void lv_obj_set_style_text_color(lv_obj_t *obj, lv_color_t value, lv_style_selector_t selector);
+void lv_obj_set_style_text_align(lv_obj_t *obj, lv_text_align_t value, lv_style_selector_t selector);
+
+lv_color_t lv_color_hex(uint32_t c);
+
+void lv_disp_set_rotation(lv_disp_t *disp, lv_disp_rot_t rotation);
+void lv_disp_flush_ready(lv_disp_drv_t *disp_drv);
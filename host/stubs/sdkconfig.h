@@ -0,0 +1,22 @@
+#pragma once
+
+// Host stand-in for the generated sdkconfig.h, with the Dishwasher options at
+// their menuconfig defaults.
+//
+
+#define CONFIG_DISHWASHER_LOG_LEVEL_PROGRAM 5
+#define CONFIG_DISHWASHER_LOG_LEVEL_DISPLAY 5
+#define CONFIG_DISHWASHER_LOG_LEVEL_MATTER 5
+#define CONFIG_DISHWASHER_LOG_LEVEL_INPUT 5
+
+#define CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ 160
+#define CONFIG_XTAL_FREQ 40
+#define CONFIG_DISHWASHER_POWER_MANAGEMENT 1
+#define CONFIG_DISHWASHER_DISPLAY_SLEEP_TIMEOUT 60
+#define CONFIG_DISHWASHER_COUNTDOWN_REPORT_INTERVAL 300
+#define CONFIG_DISHWASHER_COUNTDOWN_REPORT_THRESHOLD 10
+#define CONFIG_DISHWASHER_FORECAST_DRIFT_THRESHOLD 60
+#define CONFIG_DISHWASHER_FORECAST_SIZE_BUDGET 900
+#define CONFIG_DISHWASHER_CHECKPOINT_INTERVAL 900
+#define CONFIG_DISHWASHER_SCHEDULE_WINDOW 24
+#define CONFIG_DISHWASHER_ENDPOINT_COUNT 1
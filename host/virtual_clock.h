@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdint.h>
+
+// The deterministic clock behind the host esp_timer stand-in.
+//
+// Time only moves when the simulation asks it to, and timers fire in deadline
+// order (ties in creation order), so every run is exactly repeatable.
+//
+
+// Fires the earliest armed timer, moving the clock to its deadline. Returns
+// false when no timer is armed.
+//
+bool VirtualClockRunNext();
+
+// Fires every timer due up to and including timeUs, then leaves the clock there.
+//
+void VirtualClockAdvanceTo(uint64_t timeUs);
+
+// The deadline of the earliest armed timer, or UINT64_MAX if there isn't one.
+//
+uint64_t VirtualClockNextDeadline();
+
+uint64_t VirtualClockGetTime();
+
+// Number of callbacks fired by the timer with the given name.
+//
+uint64_t VirtualClockGetFireCount(const char *name);
+
+void VirtualClockReset();
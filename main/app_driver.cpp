@@ -6,13 +6,16 @@
    CONDITIONS OF ANY KIND, either express or implied.
 */
 
-#include <esp_log.h>
+#define DISHWASHER_LOG_LEVEL CONFIG_DISHWASHER_LOG_LEVEL_MATTER
+#include "dishwasher_log.h"
+
 #include <app_priv.h>
 #include <app-common/zap-generated/attribute-type.h>
 #include <app-common/zap-generated/cluster-enums.h>
 #include <app/util/generic-callbacks.h>
 #include <protocols/interaction_model/StatusCode.h>
 #include "dishwasher_manager.h"
+#include "dishwasher_events.h"
 #include <esp_debug_helpers.h>
 #include "iot_button.h"
 
@@ -26,16 +29,67 @@ using namespace chip::Protocols::InteractionModel;
 
 static const char *TAG = "app_driver";
 
+//************************
+//* DISHWASHER ENDPOINTS *
+//************************
+
+static DishwasherEndpoint *sDishwasherEndpoints[CONFIG_DISHWASHER_ENDPOINT_COUNT];
+static uint8_t sDishwasherEndpointCount = 0;
+
+void AddDishwasherEndpoint(DishwasherEndpoint &dishwasher)
+{
+    VerifyOrDie(sDishwasherEndpointCount < CONFIG_DISHWASHER_ENDPOINT_COUNT);
+
+    dishwasher.index = sDishwasherEndpointCount;
+    sDishwasherEndpoints[sDishwasherEndpointCount++] = &dishwasher;
+}
+
+uint8_t GetDishwasherEndpointCount()
+{
+    return sDishwasherEndpointCount;
+}
+
+DishwasherEndpoint &GetDishwasherEndpoint(uint8_t index)
+{
+    return *sDishwasherEndpoints[index];
+}
+
+DishwasherEndpoint *FindDishwasherEndpoint(EndpointId endpointId)
+{
+    for (uint8_t i = 0; i < sDishwasherEndpointCount; i++)
+    {
+        if (sDishwasherEndpoints[i]->endpointId == endpointId)
+        {
+            return sDishwasherEndpoints[i];
+        }
+    }
+
+    return nullptr;
+}
+
+DishwasherEndpoint *FindDishwasherEndpoint(const DishwasherManager &manager)
+{
+    for (uint8_t i = 0; i < sDishwasherEndpointCount; i++)
+    {
+        if (&sDishwasherEndpoints[i]->manager == &manager)
+        {
+            return sDishwasherEndpoints[i];
+        }
+    }
+
+    return nullptr;
+}
+
 DataModel::Nullable<uint32_t> OperationalStateDelegate::GetCountdownTime()
 {
-    ESP_LOGI(TAG, "GetCountdownTime");
-    uint32_t timeRemaining = DishwasherMgr().GetTimeRemaining();
+    ESP_LOGV(TAG, "GetCountdownTime");
+    uint32_t timeRemaining = mManager.GetTimeRemaining();
     return DataModel::MakeNullable(timeRemaining);
 }
 
 CHIP_ERROR OperationalStateDelegate::GetOperationalStateAtIndex(size_t index, GenericOperationalState &operationalState)
 {
-    ESP_LOGI(TAG, "GetOperationalStateAtIndex");
+    ESP_LOGV(TAG, "GetOperationalStateAtIndex");
 
     if (index > mOperationalStateList.size() - 1)
     {
@@ -49,7 +103,7 @@ CHIP_ERROR OperationalStateDelegate::GetOperationalStateAtIndex(size_t index, Ge
 
 CHIP_ERROR OperationalStateDelegate::GetOperationalPhaseAtIndex(size_t index, MutableCharSpan &operationalPhase)
 {
-    ESP_LOGI(TAG, "GetOperationalPhaseAtIndex");
+    ESP_LOGV(TAG, "GetOperationalPhaseAtIndex");
 
     if (index >= mOperationalPhaseList.size())
     {
@@ -58,26 +112,53 @@ CHIP_ERROR OperationalStateDelegate::GetOperationalPhaseAtIndex(size_t index, Mu
     return CopyCharSpanToMutableCharSpan(mOperationalPhaseList[index], operationalPhase);
 }
 
+// The commands are carried out on the dispatcher, so each is answered as soon as
+// it is queued. If the queue stays full the command is refused rather than lost.
+//
 void OperationalStateDelegate::HandlePauseStateCallback(GenericOperationalError &err)
 {
     ESP_LOGI(TAG, "HandlePauseStateCallback");
-    DishwasherMgr().PauseProgram();
+
+    // A program still waiting for its delayed start has nothing to pause yet.
+    //
+    if (!mManager.IsProgramRunning())
+    {
+        err.Set(to_underlying(ErrorStateEnum::kCommandInvalidInState));
+        return;
+    }
+
+    if (!DishwasherPostEvent(mManager, DishwasherEventType::kPauseProgram))
+    {
+        err.Set(to_underlying(ErrorStateEnum::kUnableToCompleteOperation));
+        return;
+    }
+
     err.Set(to_underlying(ErrorStateEnum::kNoError));
 }
 
 void OperationalStateDelegate::HandleResumeStateCallback(GenericOperationalError &err)
 {
     ESP_LOGI(TAG, "HandleResumeStateCallback");
-    DishwasherMgr().ResumeProgram();
+
+    if (!DishwasherPostEvent(mManager, DishwasherEventType::kResumeProgram))
+    {
+        err.Set(to_underlying(ErrorStateEnum::kUnableToStartOrResume));
+        return;
+    }
+
     err.Set(to_underlying(ErrorStateEnum::kNoError));
-    // err.Set(to_underlying(ErrorStateEnum::kUnableToCompleteOperation));
 }
 
 void OperationalStateDelegate::HandleStartStateCallback(GenericOperationalError &err)
 {
     ESP_LOGI(TAG, "HandleStartStateCallback");
 
-    DishwasherMgr().StartProgram();
+    if (!DishwasherPostEvent(mManager, DishwasherEventType::kStartProgram))
+    {
+        err.Set(to_underlying(ErrorStateEnum::kUnableToStartOrResume));
+        return;
+    }
+
     err.Set(to_underlying(ErrorStateEnum::kNoError));
 }
 
@@ -85,61 +166,43 @@ void OperationalStateDelegate::HandleStopStateCallback(GenericOperationalError &
 {
     ESP_LOGI(TAG, "HandleStopStateCallback");
 
-    DishwasherMgr().StopProgram();
-    err.Set(to_underlying(ErrorStateEnum::kNoError));
-}
-
-void OperationalStateDelegate::PostAttributeChangeCallback(AttributeId attributeId, uint8_t type, uint16_t size, uint8_t *value)
-{
-    ESP_LOGI(TAG, "OperationalStateDelegate::PostAttributeChangeCallback");
-}
-
-static OperationalState::Instance *gOperationalStateInstance = nullptr;
-static OperationalStateDelegate *gOperationalStateDelegate = nullptr;
-
-void OperationalState::Shutdown()
-{
-    if (gOperationalStateInstance != nullptr)
-    {
-        delete gOperationalStateInstance;
-        gOperationalStateInstance = nullptr;
-    }
-    if (gOperationalStateDelegate != nullptr)
+    if (!DishwasherPostEvent(mManager, DishwasherEventType::kStopProgram))
     {
-        delete gOperationalStateDelegate;
-        gOperationalStateDelegate = nullptr;
+        err.Set(to_underlying(ErrorStateEnum::kUnableToCompleteOperation));
+        return;
     }
-}
 
-OperationalState::Instance *OperationalState::GetInstance()
-{
-    return gOperationalStateInstance;
+    err.Set(to_underlying(ErrorStateEnum::kNoError));
 }
 
-OperationalState::OperationalStateDelegate *OperationalState::GetDelegate()
+void OperationalStateDelegate::PostAttributeChangeCallback(AttributeId attributeId, uint8_t type, uint16_t size, uint8_t *value)
 {
-    return gOperationalStateDelegate;
+    ESP_LOGI(TAG, "OperationalStateDelegate::PostAttributeChangeCallback");
 }
 
 void emberAfOperationalStateClusterInitCallback(chip::EndpointId endpointId)
 {
-    ESP_LOGI(TAG, "emberAfOperationalStateClusterInitCallback()");
+    ESP_LOGI(TAG, "emberAfOperationalStateClusterInitCallback(%d)", endpointId);
 
-    VerifyOrDie(endpointId == 1); // this cluster is only enabled for endpoint 1.
-    VerifyOrDie(gOperationalStateInstance == nullptr && gOperationalStateDelegate == nullptr);
+    // This cluster is only enabled on the dishwasher endpoints.
+    //
+    DishwasherEndpoint *dishwasher = FindDishwasherEndpoint(endpointId);
 
-    gOperationalStateDelegate = new OperationalStateDelegate;
-    EndpointId operationalStateEndpoint = 0x01;
-    gOperationalStateInstance = new OperationalState::Instance(gOperationalStateDelegate, operationalStateEndpoint);
+    VerifyOrDie(dishwasher != nullptr);
+    VerifyOrDie(dishwasher->operationalStateInstance == nullptr);
 
-    gOperationalStateInstance->SetOperationalState(to_underlying(OperationalState::OperationalStateEnum::kStopped));
-    gOperationalStateInstance->SetCurrentPhase(0);
+    OperationalStateDelegate *delegate = &dishwasher->operationalStateDelegate;
+    OperationalState::Instance *instance = new OperationalState::Instance(delegate, endpointId);
 
-    gOperationalStateInstance->Init();
+    instance->SetOperationalState(to_underlying(OperationalState::OperationalStateEnum::kStopped));
+    instance->SetCurrentPhase(0);
+
+    instance->Init();
+    dishwasher->operationalStateInstance = instance;
 
     uint8_t value = to_underlying(OperationalStateEnum::kStopped);
-    gOperationalStateDelegate->PostAttributeChangeCallback(chip::app::Clusters::OperationalState::Attributes::OperationalState::Id, ZCL_INT8U_ATTRIBUTE_TYPE, sizeof(uint8_t), &value);
-    gOperationalStateDelegate->PostAttributeChangeCallback(chip::app::Clusters::OperationalState::Attributes::CurrentPhase::Id, ZCL_INT8U_ATTRIBUTE_TYPE, sizeof(uint8_t), 0);
+    delegate->PostAttributeChangeCallback(chip::app::Clusters::OperationalState::Attributes::OperationalState::Id, ZCL_INT8U_ATTRIBUTE_TYPE, sizeof(uint8_t), &value);
+    delegate->PostAttributeChangeCallback(chip::app::Clusters::OperationalState::Attributes::CurrentPhase::Id, ZCL_INT8U_ATTRIBUTE_TYPE, sizeof(uint8_t), 0);
 }
 
 //****************************
@@ -151,31 +214,41 @@ template <typename T>
 using List = chip::app::DataModel::List<T>;
 using ModeTagStructType = chip::app::Clusters::detail::Structs::ModeTagStruct::Type;
 
-static DishwasherModeDelegate *gDishwasherModeDelegate = nullptr;
-static ModeBase::Instance *gDishwasherModeInstance = nullptr;
-
 CHIP_ERROR DishwasherModeDelegate::Init()
 {
     ESP_LOGI(TAG, "DishwasherModeDelegate::Init()");
 
-    gDishwasherModeInstance = mInstance;
-
     return CHIP_NO_ERROR;
 }
 
 void DishwasherModeDelegate::HandleChangeToMode(uint8_t NewMode, ModeBase::Commands::ChangeToModeResponse::Type &response)
 {
     ESP_LOGI(TAG, "DishwasherModeDelegate::HandleChangeToMode()");
-    DishwasherMgr().UpdateMode(NewMode);
+
+    // The running program's steps come from its mode, so the mode is fixed
+    // from when it is started, through any delayed start, until it stops.
+    //
+    if (mManager.IsProgramSelected())
+    {
+        response.status = to_underlying(ModeBase::StatusCode::kInvalidInMode);
+        return;
+    }
+
+    if (!DishwasherPostEvent(mManager, DishwasherEventType::kChangeMode, NewMode))
+    {
+        response.status = to_underlying(ModeBase::StatusCode::kGenericFailure);
+        return;
+    }
+
     response.status = to_underlying(ModeBase::StatusCode::kSuccess);
 }
 
 CHIP_ERROR DishwasherModeDelegate::GetModeLabelByIndex(uint8_t modeIndex, chip::MutableCharSpan &label)
 {
-    ESP_LOGI(TAG, "DishwasherModeDelegate::GetModeLabelByIndex()");
+    ESP_LOGV(TAG, "DishwasherModeDelegate::GetModeLabelByIndex()");
     if (modeIndex >= MATTER_ARRAY_SIZE(kModeOptions))
     {
-        ESP_LOGI(TAG, "CHIP_ERROR_PROVIDER_LIST_EXHAUSTED");
+        ESP_LOGV(TAG, "CHIP_ERROR_PROVIDER_LIST_EXHAUSTED");
         return CHIP_ERROR_PROVIDER_LIST_EXHAUSTED;
     }
     return chip::CopyCharSpanToMutableCharSpan(kModeOptions[modeIndex].label, label);
@@ -183,23 +256,23 @@ CHIP_ERROR DishwasherModeDelegate::GetModeLabelByIndex(uint8_t modeIndex, chip::
 
 CHIP_ERROR DishwasherModeDelegate::GetModeValueByIndex(uint8_t modeIndex, uint8_t &value)
 {
-    ESP_LOGI(TAG, "DishwasherModeDelegate::GetModeValueByIndex(%d)", modeIndex);
+    ESP_LOGV(TAG, "DishwasherModeDelegate::GetModeValueByIndex(%d)", modeIndex);
 
     if (modeIndex >= MATTER_ARRAY_SIZE(kModeOptions))
     {
-        ESP_LOGI(TAG, "CHIP_ERROR_PROVIDER_LIST_EXHAUSTED");
+        ESP_LOGV(TAG, "CHIP_ERROR_PROVIDER_LIST_EXHAUSTED");
         return CHIP_ERROR_PROVIDER_LIST_EXHAUSTED;
     }
     value = kModeOptions[modeIndex].mode;
 
-    ESP_LOGI(TAG, "DishwasherModeDelegate::GetModeValueByIndex - Returning value %d for modeIndex: %d", value, modeIndex);
+    ESP_LOGV(TAG, "DishwasherModeDelegate::GetModeValueByIndex - Returning value %d for modeIndex: %d", value, modeIndex);
 
     return CHIP_NO_ERROR;
 }
 
 CHIP_ERROR DishwasherModeDelegate::GetModeTagsByIndex(uint8_t modeIndex, List<ModeTagStructType> &tags)
 {
-    ESP_LOGI(TAG, "DishwasherModeDelegate::GetModeTagsByIndex()");
+    ESP_LOGV(TAG, "DishwasherModeDelegate::GetModeTagsByIndex()");
     if (modeIndex >= MATTER_ARRAY_SIZE(kModeOptions))
     {
         return CHIP_ERROR_PROVIDER_LIST_EXHAUSTED;
@@ -223,15 +296,15 @@ Status DishwasherModeDelegate::SetDishwasherMode(uint8_t modeValue)
     // We can only update the DishwasherMode when it's not running.
     //
 
-    VerifyOrReturnError(DishwasherMode::GetInstance() != nullptr, Status::InvalidInState);
+    VerifyOrReturnError(mInstance != nullptr, Status::InvalidInState);
 
-    if (!DishwasherMode::GetInstance()->IsSupportedMode(modeValue))
+    if (!mInstance->IsSupportedMode(modeValue))
     {
         ChipLogError(AppServer, "SetDishwasherMode bad mode");
         return Status::ConstraintError;
     }
 
-    Status status = DishwasherMode::GetInstance()->UpdateCurrentMode(modeValue);
+    Status status = mInstance->UpdateCurrentMode(modeValue);
     if (status != Status::Success)
     {
         ChipLogError(AppServer, "SetDishwasherMode updateMode failed 0x%02x", to_underlying(status));
@@ -246,43 +319,23 @@ void DishwasherModeDelegate::PostAttributeChangeCallback(AttributeId attributeId
     ESP_LOGI(TAG, "DishwasherModeDelegate::PostAttributeChangeCallback");
 }
 
-ModeBase::Instance *DishwasherMode::GetInstance()
-{
-    return gDishwasherModeInstance;
-}
-
-ModeBase::Delegate *DishwasherMode::GetDelegate()
+void emberAfDishwasherModeClusterInitCallback(chip::EndpointId endpointId)
 {
-    return gDishwasherModeDelegate;
-}
+    ESP_LOGI(TAG, "emberAfDishwasherModeClusterInitCallback(%d)", endpointId);
 
-void DishwasherMode::Shutdown()
-{
-    if (gDishwasherModeInstance != nullptr)
-    {
-        delete gDishwasherModeInstance;
-        gDishwasherModeInstance = nullptr;
-    }
-    if (gDishwasherModeDelegate != nullptr)
-    {
-        delete gDishwasherModeDelegate;
-        gDishwasherModeDelegate = nullptr;
-    }
-}
+    // This cluster is only enabled on the dishwasher endpoints.
+    //
+    DishwasherEndpoint *dishwasher = FindDishwasherEndpoint(endpointId);
 
-void emberAfDishwasherModeClusterInitCallback(chip::EndpointId endpointId)
-{
-    ESP_LOGI(TAG, "emberAfDishwasherModeClusterInitCallback()");
+    VerifyOrDie(dishwasher != nullptr);
+    VerifyOrDie(dishwasher->modeInstance == nullptr);
 
-    VerifyOrDie(endpointId == 1); // this cluster is only enabled for endpoint 1.
-    VerifyOrDie(gDishwasherModeDelegate == nullptr && gDishwasherModeInstance == nullptr);
-    gDishwasherModeDelegate = new DishwasherMode::DishwasherModeDelegate;
     // TODO Restore the deadfront support by setting the OnOff feature.
-    // gDishwasherModeInstance = new ModeBase::Instance(gDishwasherModeDelegate, 0x1, DishwasherMode::Id, chip::to_underlying(chip::app::Clusters::DishwasherMode:: ::Feature::kOnOff));
-    gDishwasherModeInstance = new ModeBase::Instance(gDishwasherModeDelegate, endpointId, DishwasherMode::Id, 0);
-    gDishwasherModeInstance->Init();
+    // dishwasher->modeInstance = new ModeBase::Instance(&dishwasher->modeDelegate, endpointId, DishwasherMode::Id, chip::to_underlying(chip::app::Clusters::DishwasherMode:: ::Feature::kOnOff));
+    dishwasher->modeInstance = new ModeBase::Instance(&dishwasher->modeDelegate, endpointId, DishwasherMode::Id, 0);
+    dishwasher->modeInstance->Init();
 
-    uint8_t currentMode = gDishwasherModeInstance->GetCurrentMode();
+    uint8_t currentMode = dishwasher->modeInstance->GetCurrentMode();
 
     ESP_LOGI(TAG, "CurrentMode: %d", currentMode);
 }
@@ -291,45 +344,225 @@ void emberAfDishwasherModeClusterInitCallback(chip::EndpointId endpointId)
 //* DEVICE ENERGY MANAGEMENT DELEGATE *
 //*************************************
 
-chip::app::Clusters::DeviceEnergyManagement::DeviceEnergyManagementDelegate device_energy_management_delegate;
-
+// The cluster server has already checked the power and duration against the
+// PowerAdjustmentCapability we published.
+//
 Status DeviceEnergyManagementDelegate::PowerAdjustRequest(const int64_t powerMw, const uint32_t durationS, AdjustmentCauseEnum cause)
 {
-    return Status::Failure;
+    ESP_LOGI(TAG, "PowerAdjustRequest received: %lld mW for %lu seconds", powerMw, durationS);
+
+    PowerCap cap;
+
+    cap.power = powerMw;
+    cap.duration = durationS;
+    cap.cause = cause == AdjustmentCauseEnum::kGridOptimization ? ForecastReason::kGridOptimization : ForecastReason::kLocalOptimization;
+
+    if (!mManager.PostPowerCap(cap))
+    {
+        return Status::Busy;
+    }
+
+    return Status::Success;
 }
 
 Status DeviceEnergyManagementDelegate::CancelPowerAdjustRequest()
 {
-    return Status::Failure;
+    ESP_LOGI(TAG, "CancelPowerAdjustRequest received");
+
+    if (mESAState != ESAStateEnum::kPowerAdjustActive)
+    {
+        return Status::InvalidInState;
+    }
+
+    if (!mManager.PostCancelPowerCap())
+    {
+        return Status::Busy;
+    }
+
+    return Status::Success;
 }
 
 Status DeviceEnergyManagementDelegate::StartTimeAdjustRequest(const uint32_t requestedStartTime, AdjustmentCauseEnum cause)
 {
     ESP_LOGI(TAG, "StartTime Adjustment received: New start time: %lu", requestedStartTime);
 
-    DishwasherMgr().AdjustStartTime(requestedStartTime);
+    // Once the program has started, or while the time isn't known, there is no
+    // start time to move.
+    //
+    if (!mManager.IsWaitingToStart() || MatterGetEpochTime() < kMinValidEpochTime)
+    {
+        return Status::InvalidInState;
+    }
+
+    if (!DishwasherPostEvent(mManager, DishwasherEventType::kAdjustStartTime, requestedStartTime))
+    {
+        return Status::Busy;
+    }
 
     return Status::Success;
 }
 
+// The cluster server has already checked the active slot can be paused for this
+// long. The pause ends by itself once the duration is up.
+//
 Status DeviceEnergyManagementDelegate::PauseRequest(const uint32_t duration, AdjustmentCauseEnum cause)
 {
-    return Status::Failure;
+    ESP_LOGI(TAG, "PauseRequest received: %lu seconds", duration);
+
+    if (!DishwasherPostEvent(mManager, DishwasherEventType::kEnergyPause, duration))
+    {
+        return Status::Busy;
+    }
+
+    return Status::Success;
 }
 
 Status DeviceEnergyManagementDelegate::ResumeRequest()
 {
-    return Status::Failure;
+    ESP_LOGI(TAG, "ResumeRequest received");
+
+    if (mESAState != ESAStateEnum::kPaused)
+    {
+        return Status::InvalidInState;
+    }
+
+    if (!DishwasherPostEvent(mManager, DishwasherEventType::kEnergyResume))
+    {
+        return Status::Busy;
+    }
+
+    return Status::Success;
 }
 
 Status DeviceEnergyManagementDelegate::ModifyForecastRequest(const uint32_t forecastID, const DataModel::DecodableList<DeviceEnergyManagement::Structs::SlotAdjustmentStruct::Type> &slotAdjustments, AdjustmentCauseEnum cause)
 {
-    return Status::Failure;
+    ESP_LOGI(TAG, "ModifyForecastRequest received for forecast %lu", forecastID);
+
+    ForecastAdjustment adjustment;
+
+    adjustment.forecastId = forecastID;
+    adjustment.reason = cause == AdjustmentCauseEnum::kGridOptimization ? ForecastReason::kGridOptimization : ForecastReason::kLocalOptimization;
+
+    auto iter = slotAdjustments.begin();
+
+    while (iter.Next())
+    {
+        if (adjustment.count == kMaxPublishedSlots)
+        {
+            return Status::ConstraintError;
+        }
+
+        const auto &slot_adjustment = iter.GetValue();
+        ForecastSlotAdjustment &slot = adjustment.slots[adjustment.count++];
+
+        slot.slotIndex = slot_adjustment.slotIndex;
+        slot.duration = slot_adjustment.duration;
+        slot.hasNominalPower = slot_adjustment.nominalPower.HasValue();
+        slot.nominalPower = slot.hasNominalPower ? slot_adjustment.nominalPower.Value() : 0;
+    }
+
+    if (iter.GetStatus() != CHIP_NO_ERROR)
+    {
+        return Status::InvalidCommand;
+    }
+
+    if (HasRepeatedForecastSlot(adjustment))
+    {
+        return Status::ConstraintError;
+    }
+
+    if (!mManager.PostForecastAdjustment(adjustment))
+    {
+        return Status::Busy;
+    }
+
+    return Status::Success;
 }
 
+// The constraints are turned into a tariff for the scheduler. Where the energy
+// manager asks for more load (a positive LoadControl) it is cheaper to run, and
+// where it asks for less it is dearer. The cluster server has already checked
+// they are in order and don't overlap.
+//
 Status DeviceEnergyManagementDelegate::RequestConstraintBasedForecast(const DataModel::DecodableList<DeviceEnergyManagement::Structs::ConstraintsStruct::Type> &constraints, AdjustmentCauseEnum cause)
 {
-    return Status::Failure;
+    ESP_LOGI(TAG, "RequestConstraintBasedForecast received");
+
+    // Only ever used on the Matter thread, and too big for its stack.
+    //
+    static TariffCurve tariff;
+
+    tariff = TariffCurve();
+
+    uint32_t first_start = 0;
+    uint32_t last_end = 0;
+    bool is_first = true;
+
+    auto iter = constraints.begin();
+
+    while (iter.Next())
+    {
+        const auto &constraint = iter.GetValue();
+
+        if (is_first)
+        {
+            first_start = constraint.startTime;
+            is_first = false;
+        }
+
+        last_end = constraint.startTime + constraint.duration;
+    }
+
+    if (iter.GetStatus() != CHIP_NO_ERROR)
+    {
+        return Status::InvalidCommand;
+    }
+
+    if (!is_first && last_end > first_start)
+    {
+        uint32_t span = last_end - first_start;
+
+        tariff.startTime = first_start;
+        tariff.bucketDuration = (span + kMaxTariffBuckets - 1) / kMaxTariffBuckets;
+        tariff.bucketCount = (uint8_t)((span + tariff.bucketDuration - 1) / tariff.bucketDuration);
+
+        if (tariff.bucketDuration < 60)
+        {
+            tariff.bucketDuration = 60;
+            tariff.bucketCount = (uint8_t)((span + 59) / 60);
+        }
+
+        // Each bucket takes the constraint covering its middle, if there is one.
+        //
+        iter = constraints.begin();
+
+        while (iter.Next())
+        {
+            const auto &constraint = iter.GetValue();
+
+            if (!constraint.loadControl.HasValue())
+            {
+                continue;
+            }
+
+            for (uint8_t i = 0; i < tariff.bucketCount; i++)
+            {
+                uint32_t middle = tariff.startTime + i * tariff.bucketDuration + tariff.bucketDuration / 2;
+
+                if (middle >= constraint.startTime && middle < constraint.startTime + constraint.duration)
+                {
+                    tariff.costs[i] = -constraint.loadControl.Value();
+                }
+            }
+        }
+    }
+
+    if (!mManager.PostTariff(tariff))
+    {
+        return Status::Busy;
+    }
+
+    return Status::Success;
 }
 
 Status DeviceEnergyManagementDelegate::CancelRequest()
@@ -349,7 +582,7 @@ bool DeviceEnergyManagementDelegate::GetESACanGenerate()
 
 ESAStateEnum DeviceEnergyManagementDelegate::GetESAState()
 {
-    return ESAStateEnum::kOnline;
+    return mESAState;
 }
 
 int64_t DeviceEnergyManagementDelegate::GetAbsMinPower()
@@ -359,7 +592,7 @@ int64_t DeviceEnergyManagementDelegate::GetAbsMinPower()
 
 int64_t DeviceEnergyManagementDelegate::GetAbsMaxPower()
 {
-    return 1000;
+    return GetWashProgramsMaxPower();
 }
 
 OptOutStateEnum DeviceEnergyManagementDelegate::GetOptOutState()
@@ -375,6 +608,14 @@ void DeviceEnergyManagementDelegate::SetOptOutState(OptOutStateEnum state)
 
 CHIP_ERROR DeviceEnergyManagementDelegate::SetESAState(ESAStateEnum newValue)
 {
+    if (mESAState == newValue)
+    {
+        return CHIP_NO_ERROR;
+    }
+
+    mESAState = newValue;
+    MatterReportingAttributeChangeCallback(DeviceEnergyManagementDelegate::mEndpointId, DeviceEnergyManagement::Id, DeviceEnergyManagement::Attributes::ESAState::Id);
+
     return CHIP_NO_ERROR;
 }
 
@@ -383,31 +624,47 @@ chip::app::DataModel::Nullable<DeviceEnergyManagement::Structs::PowerAdjustCapab
     return mPowerAdjustCapabilityStruct;
 }
 
+CHIP_ERROR DeviceEnergyManagementDelegate::SetPowerAdjustmentCapability(const chip::app::DataModel::Nullable<DeviceEnergyManagement::Structs::PowerAdjustCapabilityStruct::Type> &capability)
+{
+    mPowerAdjustCapabilityStruct = capability;
+
+    MatterReportingAttributeChangeCallback(DeviceEnergyManagementDelegate::mEndpointId, DeviceEnergyManagement::Id, DeviceEnergyManagement::Attributes::PowerAdjustmentCapability::Id);
+
+    return CHIP_NO_ERROR;
+}
+
 chip::app::DataModel::Nullable<DeviceEnergyManagement::Structs::ForecastStruct::Type> &DeviceEnergyManagementDelegate::GetForecast()
 {
-    ESP_LOGI(TAG, "Returning Forecast...");
+    ESP_LOGV(TAG, "Returning Forecast...");
+
+    chip::app::DataModel::Nullable<DeviceEnergyManagement::Structs::ForecastStruct::Type> &forecast = mForecastStore.GetForecast();
 
-    if (mForecast.IsNull())
+    if (forecast.IsNull())
     {
-        ESP_LOGI(TAG, "Forecast is null :(");
+        ESP_LOGV(TAG, "Forecast is null :(");
     }
     else
     {
-        ESP_LOGI(TAG, "Forecast start time: %lu", mForecast.Value().startTime);
-        ESP_LOGI(TAG, "Forecast slots: %d", mForecast.Value().slots.size());
+        ESP_LOGV(TAG, "Forecast start time: %lu", forecast.Value().startTime);
+        ESP_LOGV(TAG, "Forecast slots: %d", forecast.Value().slots.size());
     }
 
-    ESP_LOGI(TAG, "Current Free Memory\t%d\t\t%d", heap_caps_get_free_size(MALLOC_CAP_8BIT) - heap_caps_get_free_size(MALLOC_CAP_SPIRAM), heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
-    ESP_LOGI(TAG, "Largest Free Block\t%d\t\t%d", heap_caps_get_largest_free_block(MALLOC_CAP_8BIT | MALLOC_CAP_INTERNAL), heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM));
-    ESP_LOGI(TAG, "Min. Ever Free Size\t%d\t\t%d", heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT | MALLOC_CAP_INTERNAL), heap_caps_get_minimum_free_size(MALLOC_CAP_SPIRAM));
+    return forecast;
+}
 
-    return mForecast;
+ForecastStore &DeviceEnergyManagementDelegate::GetForecastStore()
+{
+    return mForecastStore;
 }
 
-CHIP_ERROR DeviceEnergyManagementDelegate::SetForecast(const chip::app::DataModel::Nullable<DeviceEnergyManagement::Structs::ForecastStruct::Type> &forecast)
+CHIP_ERROR DeviceEnergyManagementDelegate::PublishForecast()
 {
     ESP_LOGI(TAG, "Updating Forecast on Endpoint %d...", DeviceEnergyManagementDelegate::mEndpointId);
 
+    mForecastStore.Swap();
+
+    const chip::app::DataModel::Nullable<DeviceEnergyManagement::Structs::ForecastStruct::Type> &forecast = mForecastStore.GetForecast();
+
     if (forecast.IsNull())
     {
         ESP_LOGI(TAG, "Forecast is null :(");
@@ -418,8 +675,6 @@ CHIP_ERROR DeviceEnergyManagementDelegate::SetForecast(const chip::app::DataMode
         ESP_LOGI(TAG, "Forecast slots: %d", forecast.Value().slots.size());
     }
 
-    mForecast = forecast;
-
     MatterReportingAttributeChangeCallback(DeviceEnergyManagementDelegate::mEndpointId, DeviceEnergyManagement::Id, DeviceEnergyManagement::Attributes::Forecast::Id);
 
     return CHIP_NO_ERROR;
@@ -427,7 +682,8 @@ CHIP_ERROR DeviceEnergyManagementDelegate::SetForecast(const chip::app::DataMode
 
 void emberAfDeviceEnergyManagementClusterInitCallback(chip::EndpointId endpointId)
 {
-    ESP_LOGI(TAG, "emberAfDeviceEnergyManagerClusterInitCallback()");
+    ESP_LOGI(TAG, "emberAfDeviceEnergyManagerClusterInitCallback(%d)", endpointId);
+    ESP_LOGI(TAG, "Forecast store takes %u bytes", (unsigned)ForecastStore::GetFootprint());
 
     // VerifyOrDie(endpointId == 1); // this cluster is only enabled for endpoint 1.
     // VerifyOrDie(gOperationalStateInstance == nullptr && gOperationalStateDelegate == nullptr);
@@ -452,37 +708,42 @@ void emberAfDeviceEnergyManagementClusterInitCallback(chip::EndpointId endpointI
 static void onoff_button_single_click_cb(void *args, void *user_data)
 {
     ESP_LOGI(TAG, "OnOff Clicked");
-    DishwasherMgr().HandleOnOffClicked();
+    DishwasherPostEvent(DishwasherEventType::kOnOffClicked);
 }
 
 static void onoff_button_long_press_start_cb(void *args, void *user_data)
 {
     ESP_LOGI(TAG, "OnOff Long Press Start");
-    DishwasherMgr().PresentReset();
+    DishwasherPostEvent(DishwasherEventType::kOnOffLongPressed);
 }
 
 static void start_button_single_click_cb(void *args, void *user_data)
 {
     ESP_LOGI(TAG, "Start Clicked");
-    DishwasherMgr().HandleStartClicked();
+    DishwasherPostEvent(DishwasherEventType::kStartClicked);
 }
 
 static void rotary_button_single_click_cb(void *args, void *user_data)
 {
     ESP_LOGI(TAG, "Rotary Clicked");
-    DishwasherMgr().HandleWheelClicked();
+    DishwasherPostEvent(DishwasherEventType::kWheelClicked);
 }
 
 esp_err_t app_driver_init()
 {
     esp_err_t err = ESP_OK;
 
+    // With power save enabled, a press wakes the chip from light sleep.
+    //
     button_config_t onoff_config;
     memset(&onoff_config, 0, sizeof(button_config_t));
 
     onoff_config.type = BUTTON_TYPE_GPIO;
     onoff_config.gpio_button_config.gpio_num = GPIO_NUM_0;
     onoff_config.gpio_button_config.active_level = 1;
+#if CONFIG_GPIO_BUTTON_SUPPORT_POWER_SAVE
+    onoff_config.gpio_button_config.enable_power_save = true;
+#endif
 
     button_handle_t onoff_handle = iot_button_create(&onoff_config);
 
@@ -495,6 +756,9 @@ esp_err_t app_driver_init()
     start_config.type = BUTTON_TYPE_GPIO;
     start_config.gpio_button_config.gpio_num = GPIO_NUM_1;
     start_config.gpio_button_config.active_level = 1;
+#if CONFIG_GPIO_BUTTON_SUPPORT_POWER_SAVE
+    start_config.gpio_button_config.enable_power_save = true;
+#endif
 
     button_handle_t start_handle = iot_button_create(&start_config);
 
@@ -506,6 +770,9 @@ esp_err_t app_driver_init()
     rotary_config.type = BUTTON_TYPE_GPIO;
     rotary_config.gpio_button_config.gpio_num = GPIO_NUM_2;
     rotary_config.gpio_button_config.active_level = 0;
+#if CONFIG_GPIO_BUTTON_SUPPORT_POWER_SAVE
+    rotary_config.gpio_button_config.enable_power_save = true;
+#endif
 
     button_handle_t rotary_handle = iot_button_create(&rotary_config);
 
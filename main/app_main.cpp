@@ -19,6 +19,10 @@
 #include <app-common/zap-generated/ids/Attributes.h> // For Attribute IDs
 
 #include "dishwasher_manager.h"
+#include "dishwasher_events.h"
+#include "dishwasher_console.h"
+#include "boot_profiler.h"
+#include "telemetry.h"
 
 #include "esp_netif_sntp.h"
 
@@ -27,8 +31,6 @@
 #endif
 
 static const char *TAG = "app_main";
-static uint16_t dish_washer_endpoint_id = 0;
-static uint16_t device_energy_manager_endpoint_id = 0;
 
 using namespace esp_matter;
 using namespace esp_matter::attribute;
@@ -67,6 +69,7 @@ static void app_event_cb(const ChipDeviceEvent *event, intptr_t arg)
 
     case chip::DeviceLayer::DeviceEventType::kCommissioningWindowOpened:
         ESP_LOGI(TAG, "Commissioning window opened");
+        BootProfilerMark(BootStage::kCommissionable);
         // chip::RendezvousInformationFlag(chip::RendezvousInformationFlag::kBLE);
         break;
 
@@ -80,6 +83,12 @@ static void app_event_cb(const ChipDeviceEvent *event, intptr_t arg)
 
     case chip::DeviceLayer::DeviceEventType::kServerReady:
         ESP_LOGI(TAG, "Server is ready!");
+        BootProfilerMark(BootStage::kServerReady);
+
+        // Changes made before the stack was up, such as a program resumed at boot,
+        // were held until now.
+        //
+        MatterServerReady();
         break;
 
     default:
@@ -104,22 +113,17 @@ static esp_err_t app_attribute_update_cb(callback_type_t type, uint16_t endpoint
 
     if (type == POST_UPDATE)
     {
-        if (endpoint_id == 0x01)
+        DishwasherEndpoint *dishwasher = FindDishwasherEndpoint(endpoint_id);
+
+        if (dishwasher != nullptr)
         {
             if (cluster_id == OnOff::Id)
             {
                 if (attribute_id == OnOff::Attributes::OnOff::Id)
                 {
-                    ESP_LOGI(TAG, "OnOff attribute updated to: %s!", val->val.b ? "on" : "off");
-
-                    if (val->val.b)
-                    {
-                        DishwasherMgr().TurnOnPower();
-                    }
-                    else
-                    {
-                        DishwasherMgr().TurnOffPower();
-                    }
+                    ESP_LOGI(TAG, "OnOff attribute on endpoint %d updated to: %s!", endpoint_id, val->val.b ? "on" : "off");
+
+                    DishwasherPostEvent(dishwasher->manager, DishwasherEventType::kSetPower, val->val.b);
                 }
             }
         }
@@ -128,27 +132,31 @@ static esp_err_t app_attribute_update_cb(callback_type_t type, uint16_t endpoint
     return ESP_OK;
 }
 
+// A program restored at boot, before the time was known, catches up on the
+// time the device was off from here.
+//
 static void esp_sntp_time_cb(struct timeval *tv) 
 {
     ESP_LOGI(TAG, "TIME SET!");
-}
 
-extern "C" void app_main()
-{
-    esp_err_t err = ESP_OK;
-
-    /* Initialize the ESP NVS layer */
-    nvs_flash_init();
-
-    /* Create a Matter node and add the mandatory Root Node device type on endpoint 0 */
-    node::config_t node_config;
-    node_t *node = node::create(&node_config, app_attribute_update_cb, app_identification_cb);
-    ABORT_APP_ON_FAILURE(node != nullptr, ESP_LOGE(TAG, "Failed to create Matter node"));
+    for (uint8_t i = 0; i < GetDishwasherEndpointCount(); i++)
+    {
+        DishwasherPostEvent(GetDishwasherEndpoint(i).manager, DishwasherEventType::kTimeSet);
+    }
+}
 
-    static OperationalStateDelegate operational_state_delegate;
+// NVS keys for the checkpoints of the dishwashers after the first, which keeps
+// the original "program".
+//
+static char sCheckpointKeys[CONFIG_DISHWASHER_ENDPOINT_COUNT][16];
 
+// Adds the dishwasher's endpoint, with its OperationalState, DishwasherMode and
+// OnOff clusters, and its DeviceEnergyManagement endpoint.
+//
+static void CreateDishwasherEndpoints(node_t *node, DishwasherEndpoint &dishwasher)
+{
     dish_washer::config_t dish_washer_config;
-    dish_washer_config.operational_state.delegate = &operational_state_delegate; // Set to nullptr if not using a delegate
+    dish_washer_config.operational_state.delegate = &dishwasher.operationalStateDelegate; // Set to nullptr if not using a delegate
 
     endpoint_t *endpoint = dish_washer::create(node, &dish_washer_config, ENDPOINT_FLAG_NONE, NULL);
     ABORT_APP_ON_FAILURE(endpoint != nullptr, ESP_LOGE(TAG, "Failed to create dishwasher endpoint"));
@@ -191,26 +199,77 @@ extern "C" void app_main()
     on_off_config.on_off = false; // Initial state of the On/Off cluster
     esp_matter::cluster::on_off::create(endpoint, &on_off_config, CLUSTER_FLAG_SERVER, esp_matter::cluster::on_off::feature::dead_front_behavior::get_id());
 
-    dish_washer_endpoint_id = endpoint::get_id(endpoint);
-    ESP_LOGI(TAG, "Dishwasher created with endpoint_id %d", dish_washer_endpoint_id);
+    dishwasher.endpointId = endpoint::get_id(endpoint);
+    ESP_LOGI(TAG, "Dishwasher created with endpoint_id %d", dishwasher.endpointId);
 
     /*
      * Add DeviceEnergyManagement
      */
     esp_matter::endpoint::device_energy_management::config_t device_energy_management_config;
-    device_energy_management_config.device_energy_management.feature_flags = esp_matter::cluster::device_energy_management::feature::power_forecast_reporting::get_id() | esp_matter::cluster::device_energy_management::feature::start_time_adjustment::get_id();
-    device_energy_management_config.device_energy_management.delegate = &device_energy_management_delegate;
+    device_energy_management_config.device_energy_management.feature_flags = esp_matter::cluster::device_energy_management::feature::power_forecast_reporting::get_id() | esp_matter::cluster::device_energy_management::feature::start_time_adjustment::get_id() | esp_matter::cluster::device_energy_management::feature::constraint_based_adjustment::get_id() | esp_matter::cluster::device_energy_management::feature::power_adjustment::get_id() | esp_matter::cluster::device_energy_management::feature::pausable::get_id() | esp_matter::cluster::device_energy_management::feature::forecast_adjustment::get_id();
+    device_energy_management_config.device_energy_management.delegate = &dishwasher.energyDelegate;
 
     endpoint_t *device_energy_management_endpoint = esp_matter::endpoint::device_energy_management::create(node, &device_energy_management_config, ENDPOINT_FLAG_NONE, ESP_MATTER_NONE_FEATURE_ID);
     ABORT_APP_ON_FAILURE(device_energy_management_endpoint != nullptr, ESP_LOGE(TAG, "Failed to create device energy management endpoint"));
 
-    device_energy_manager_endpoint_id = endpoint::get_id(device_energy_management_endpoint);
-    ESP_LOGI(TAG, "Device Energy Manager created with endpoint_id %d", device_energy_manager_endpoint_id);
+    dishwasher.energyEndpointId = endpoint::get_id(device_energy_management_endpoint);
+    ESP_LOGI(TAG, "Device Energy Manager created with endpoint_id %d", dishwasher.energyEndpointId);
+}
 
-    err = DishwasherMgr().Init();
-    ABORT_APP_ON_FAILURE(err == ESP_OK, ESP_LOGE(TAG, "DishwasherMgr::Init() failed, err:%d", err));
+extern "C" void app_main()
+{
+    esp_err_t err = ESP_OK;
+
+    BootProfilerMark(BootStage::kAppMain);
+
+    /* Initialize the ESP NVS layer */
+    nvs_flash_init();
+    BootProfilerMark(BootStage::kNvsReady);
+
+    TelemetryMgr().Init();
+
+    /* Create a Matter node and add the mandatory Root Node device type on endpoint 0 */
+    node::config_t node_config;
+    node_t *node = node::create(&node_config, app_attribute_update_cb, app_identification_cb);
+    ABORT_APP_ON_FAILURE(node != nullptr, ESP_LOGE(TAG, "Failed to create Matter node"));
+
+    // The first dishwasher is the one with the display and buttons. Any others
+    // only exist over Matter, each with its own program checkpoint.
+    //
+    for (uint8_t i = 0; i < CONFIG_DISHWASHER_ENDPOINT_COUNT; i++)
+    {
+        DishwasherManager *manager = &DishwasherMgr();
+
+        if (i > 0)
+        {
+            snprintf(sCheckpointKeys[i], sizeof(sCheckpointKeys[i]), "program%u", (unsigned)i);
+
+            manager = new DishwasherManager({
+                .checkpointKey = sCheckpointKeys[i],
+                .hasFrontPanel = false,
+            });
+        }
+
+        DishwasherEndpoint *dishwasher = new DishwasherEndpoint(*manager);
+
+        CreateDishwasherEndpoints(node, *dishwasher);
+        AddDishwasherEndpoint(*dishwasher);
+    }
+
+    BootProfilerMark(BootStage::kEndpointsCreated);
+
+    // The display and encoder are brought up by the dishwasher task from here on,
+    // alongside the rest of this function.
+    //
+    for (uint8_t i = 0; i < GetDishwasherEndpointCount(); i++)
+    {
+        err = GetDishwasherEndpoint(i).manager.Init();
+        ABORT_APP_ON_FAILURE(err == ESP_OK, ESP_LOGE(TAG, "DishwasherManager::Init() failed for dishwasher %d, err:%d", i, err));
+    }
+    BootProfilerMark(BootStage::kManagerReady);
 
     app_driver_init();
+    BootProfilerMark(BootStage::kDriverReady);
 
 #if CHIP_DEVICE_CONFIG_ENABLE_THREAD
     /* Set OpenThread platform config */
@@ -229,10 +288,18 @@ extern "C" void app_main()
     /* Matter start */
     err = esp_matter::start(app_event_cb);
     ABORT_APP_ON_FAILURE(err == ESP_OK, ESP_LOGE(TAG, "Failed to start Matter, err:%d", err));
+    BootProfilerMark(BootStage::kMatterStarted);
 
 #if CONFIG_ENABLE_CHIP_SHELL
     esp_matter::console::diagnostics_register_commands();
     esp_matter::console::wifi_register_commands();
+    DishwasherConsoleRegisterCommands();
     esp_matter::console::init();
 #endif
+
+#if CONFIG_DISHWASHER_BENCHMARK
+    // On the dispatcher, after StartUp has brought up the display they drive.
+    //
+    DishwasherPostEvent(DishwasherEventType::kRunBenchmarks, CONFIG_DISHWASHER_BENCHMARK_ITERATIONS);
+#endif
 }
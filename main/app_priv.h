@@ -19,8 +19,16 @@
 #include <app/clusters/device-energy-management-server/device-energy-management-server.h>
 #include <protocols/interaction_model/StatusCode.h>
 
+#include <array>
+#include <utility>
+
+#include "wash_programs.h"
+#include "forecast_store.h"
+
 typedef void *app_driver_handle_t;
 
+class DishwasherManager;
+
 using namespace chip;
 using namespace chip::app;
 using namespace chip::app::Clusters;
@@ -62,6 +70,8 @@ namespace chip
                 class OperationalStateDelegate : public Delegate
                 {
                 public:
+                    explicit OperationalStateDelegate(DishwasherManager &manager) : mManager(manager) {}
+
                     uint32_t mRunningTime = 0;
                     uint32_t mPausedTime = 0;
 
@@ -84,6 +94,8 @@ namespace chip
                     void PostAttributeChangeCallback(AttributeId attributeId, uint8_t type, uint16_t size, uint8_t *value);
 
                 private:
+                    DishwasherManager &mManager;
+
                     const GenericOperationalState opStateList[4] = {
                         GenericOperationalState(to_underlying(OperationalStateEnum::kStopped)),
                         GenericOperationalState(to_underlying(OperationalStateEnum::kRunning)),
@@ -92,14 +104,15 @@ namespace chip
                     };
                     app::DataModel::List<const GenericOperationalState> mOperationalStateList = Span<const GenericOperationalState>(opStateList);
 
-                    const CharSpan phaseList[5] = {"pre-soak"_span, "main-wash"_span, "rinse"_span, "final-rinse"_span, "drying"_span};
-                    Span<const CharSpan> mOperationalPhaseList = Span<const CharSpan>(phaseList);
-                };
-
-                OperationalState::Instance *GetInstance();
-                OperationalState::OperationalStateDelegate *GetDelegate();
+                    template <size_t... I>
+                    static std::array<CharSpan, sizeof...(I)> MakePhaseList(std::index_sequence<I...>)
+                    {
+                        return {{CharSpan::fromCharString(kWashPhaseNames[I])...}};
+                    }
 
-                void Shutdown();
+                    const std::array<CharSpan, kWashPhaseCount> phaseList = MakePhaseList(std::make_index_sequence<kWashPhaseCount>());
+                    Span<const CharSpan> mOperationalPhaseList = Span<const CharSpan>(phaseList.data(), phaseList.size());
+                };
 
             } // namespace OperationalState
         } // namespace Clusters
@@ -122,36 +135,51 @@ namespace chip
                 {
                 private:
                     using ModeTagStructType = detail::Structs::ModeTagStruct::Type;
-                    ModeTagStructType modeTagsNormal[1] = {{.value = to_underlying(ModeTag::kNormal)}};
-                    ModeTagStructType modeTagsHeavy[2] = {{.value = to_underlying(ModeBase::ModeTag::kMax)},
-                                                          {.value = to_underlying(ModeTag::kHeavy)}};
-                    ModeTagStructType modeTagsLight[3] = {{.value = to_underlying(ModeTag::kLight)},
+
+                    DishwasherManager &mManager;
+
+                    // Mode tags for each entry in kWashPrograms, in the same order.
+                    //
+                    ModeTagStructType modeTagsEco[2] = {{.value = to_underlying(ModeTag::kNormal)},
+                                                        {.value = to_underlying(ModeBase::ModeTag::kLowEnergy)}};
+                    ModeTagStructType modeTagsChef[2] = {{.value = to_underlying(ModeBase::ModeTag::kMax)},
+                                                         {.value = to_underlying(ModeTag::kHeavy)}};
+                    ModeTagStructType modeTagsQuick[3] = {{.value = to_underlying(ModeTag::kLight)},
                                                           {.value = to_underlying(ModeBase::ModeTag::kNight)},
                                                           {.value = to_underlying(ModeBase::ModeTag::kQuiet)}};
+                    ModeTagStructType modeTagsAuto[2] = {{.value = to_underlying(ModeTag::kNormal)},
+                                                         {.value = to_underlying(ModeBase::ModeTag::kAuto)}};
+                    ModeTagStructType modeTagsGlass[1] = {{.value = to_underlying(ModeTag::kLight)}};
+                    ModeTagStructType modeTagsSilence[3] = {{.value = to_underlying(ModeTag::kNormal)},
+                                                            {.value = to_underlying(ModeBase::ModeTag::kQuiet)},
+                                                            {.value = to_underlying(ModeBase::ModeTag::kLowNoise)}};
+                    ModeTagStructType modeTagsPreRinse[2] = {{.value = to_underlying(ModeTag::kLight)},
+                                                             {.value = to_underlying(ModeBase::ModeTag::kMin)}};
+                    ModeTagStructType modeTagsShort[2] = {{.value = to_underlying(ModeTag::kNormal)},
+                                                          {.value = to_underlying(ModeBase::ModeTag::kQuick)}};
+                    ModeTagStructType modeTagsMachineCare[2] = {{.value = to_underlying(ModeTag::kHeavy)},
+                                                                {.value = to_underlying(ModeBase::ModeTag::kMax)}};
+
+                    template <size_t N>
+                    static detail::Structs::ModeOptionStruct::Type MakeModeOption(uint8_t mode, ModeTagStructType (&modeTags)[N])
+                    {
+                        return detail::Structs::ModeOptionStruct::Type{.label = CharSpan::fromCharString(kWashPrograms[mode].label),
+                                                                       .mode = mode,
+                                                                       .modeTags = DataModel::List<const ModeTagStructType>(modeTags)};
+                    }
 
-                    // These are the modes on my dishwasher.
-                    // TODO Implement these with the appropriate ModeTags.
-                    //
-                    // Eco 50°
-                    // Chef 70°
-                    // Auto 45° - 65°
-                    // Glass 40°
-                    // Silence 50°
-                    // Pre Rinse
-                    // Quick 45°
-                    // Short 60°
-                    // Machine Care
-
-                    const detail::Structs::ModeOptionStruct::Type kModeOptions[3] = {
-                        detail::Structs::ModeOptionStruct::Type{.label = CharSpan::fromCharString("Eco 50°"),
-                                                                .mode = ModeNormal,
-                                                                .modeTags = DataModel::List<const ModeTagStructType>(modeTagsNormal)},
-                        detail::Structs::ModeOptionStruct::Type{.label = CharSpan::fromCharString("Chef 70°"),
-                                                                .mode = ModeHeavy,
-                                                                .modeTags = DataModel::List<const ModeTagStructType>(modeTagsHeavy)},
-                        detail::Structs::ModeOptionStruct::Type{.label = CharSpan::fromCharString("Quick 45°"),
-                                                                .mode = ModeLight,
-                                                                .modeTags = DataModel::List<const ModeTagStructType>(modeTagsLight)}};
+                    const detail::Structs::ModeOptionStruct::Type kModeOptions[kWashProgramCount] = {
+                        MakeModeOption(0, modeTagsEco),
+                        MakeModeOption(1, modeTagsChef),
+                        MakeModeOption(2, modeTagsQuick),
+                        MakeModeOption(3, modeTagsAuto),
+                        MakeModeOption(4, modeTagsGlass),
+                        MakeModeOption(5, modeTagsSilence),
+                        MakeModeOption(6, modeTagsPreRinse),
+                        MakeModeOption(7, modeTagsShort),
+                        MakeModeOption(8, modeTagsMachineCare)};
+
+                    static_assert(kWashProgramCount == 9, "Every program in kWashPrograms needs its mode tags listed here");
 
                     CHIP_ERROR Init() override;
                     void HandleChangeToMode(uint8_t mode, ModeBase::Commands::ChangeToModeResponse::Type &response) override;
@@ -160,6 +188,7 @@ namespace chip
                     CHIP_ERROR GetModeTagsByIndex(uint8_t modeIndex, DataModel::List<ModeTagStructType> &tags) override;
 
                 public:
+                    explicit DishwasherModeDelegate(DishwasherManager &manager) : mManager(manager) {}
                     ~DishwasherModeDelegate() override = default;
 
                     CHIP_ERROR GetModeLabelByIndex(uint8_t modeIndex, MutableCharSpan &label) override;
@@ -169,11 +198,6 @@ namespace chip
                     Protocols::InteractionModel::Status SetDishwasherMode(uint8_t mode);
                 };
 
-                ModeBase::Instance *GetInstance();
-                ModeBase::Delegate *GetDelegate();
-
-                void Shutdown();
-
             } // namespace DishwasherMode
 
         } // namespace Clusters
@@ -191,12 +215,7 @@ namespace chip
                 class DeviceEnergyManagementDelegate : public DeviceEnergyManagement::Delegate
                 {
                 public:
-
-                    DeviceEnergyManagementDelegate()
-                    { 
-                        // Left as an example of constructor
-                        ESP_LOGI("DeviceEnergyManagementDelegate", "Constructing");
-                    }
+                    explicit DeviceEnergyManagementDelegate(DishwasherManager &manager) : mManager(manager) {}
 
                     Status PowerAdjustRequest(const int64_t powerMw, const uint32_t durationS, AdjustmentCauseEnum cause);
                     Status CancelPowerAdjustRequest();
@@ -216,24 +235,64 @@ namespace chip
                     void SetOptOutState(OptOutStateEnum state);
 
                     CHIP_ERROR SetESAState(ESAStateEnum newValue);
+                    CHIP_ERROR SetPowerAdjustmentCapability(const chip::app::DataModel::Nullable<DeviceEnergyManagement::Structs::PowerAdjustCapabilityStruct::Type> &);
 
                     chip::app::DataModel::Nullable<DeviceEnergyManagement::Structs::PowerAdjustCapabilityStruct::Type> &GetPowerAdjustmentCapability() override;
                     chip::app::DataModel::Nullable<DeviceEnergyManagement::Structs::ForecastStruct::Type> &GetForecast() override;
 
-                    CHIP_ERROR SetForecast(const chip::app::DataModel::Nullable<DeviceEnergyManagement::Structs::ForecastStruct::Type> &);
+                    // The next forecast is built in GetForecastStore().GetBackBuffer(),
+                    // then PublishForecast swaps it in and reports it.
+                    //
+                    ForecastStore &GetForecastStore();
+                    CHIP_ERROR PublishForecast();
 
                     ~DeviceEnergyManagementDelegate() override = default;
 
                 private:
+                    DishwasherManager &mManager;
                     chip::app::DataModel::Nullable<DeviceEnergyManagement::Structs::PowerAdjustCapabilityStruct::Type> mPowerAdjustCapabilityStruct;
-                    chip::app::DataModel::Nullable<DeviceEnergyManagement::Structs::ForecastStruct::Type> mForecast;
+                    ForecastStore mForecastStore;
                     OptOutStateEnum mOptOutState = OptOutStateEnum::kOptOut;
+                    ESAStateEnum mESAState = ESAStateEnum::kOnline;
                 };
-
-                void Shutdown();
             }
         }
     }
 }
 
-extern chip::app::Clusters::DeviceEnergyManagement::DeviceEnergyManagementDelegate device_energy_management_delegate;
\ No newline at end of file
+// One dishwasher as the Matter stack sees it: its endpoint, its own
+// DeviceEnergyManagement endpoint, and the delegates and cluster instances
+// serving them, all working on the one DishwasherManager.
+//
+// app_main adds one for each of DISHWASHER_ENDPOINT_COUNT before starting
+// Matter, so the cluster init callbacks can find theirs by endpoint. The first
+// is DishwasherMgr(), with the display and buttons.
+//
+struct DishwasherEndpoint
+{
+    explicit DishwasherEndpoint(DishwasherManager &dishwasher) : manager(dishwasher), operationalStateDelegate(dishwasher), modeDelegate(dishwasher), energyDelegate(dishwasher) {}
+
+    DishwasherManager &manager;
+    uint8_t index = 0;
+
+    EndpointId endpointId = kInvalidEndpointId;
+    EndpointId energyEndpointId = kInvalidEndpointId;
+
+    OperationalStateDelegate operationalStateDelegate;
+    OperationalState::Instance *operationalStateInstance = nullptr;
+
+    DishwasherModeDelegate modeDelegate;
+    ModeBase::Instance *modeInstance = nullptr;
+
+    DeviceEnergyManagementDelegate energyDelegate;
+};
+
+void AddDishwasherEndpoint(DishwasherEndpoint &dishwasher);
+
+uint8_t GetDishwasherEndpointCount();
+DishwasherEndpoint &GetDishwasherEndpoint(uint8_t index);
+
+// nullptr if the endpoint or manager isn't a dishwasher's.
+//
+DishwasherEndpoint *FindDishwasherEndpoint(EndpointId endpointId);
+DishwasherEndpoint *FindDishwasherEndpoint(const DishwasherManager &manager);
\ No newline at end of file
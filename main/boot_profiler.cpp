@@ -0,0 +1,65 @@
+#define DISHWASHER_LOG_LEVEL CONFIG_DISHWASHER_LOG_LEVEL_PROGRAM
+#include "dishwasher_log.h"
+
+#include "boot_profiler.h"
+
+#include <esp_timer.h>
+
+#include <atomic>
+
+static const char *TAG = "boot_profiler";
+
+static std::atomic<uint32_t> sStageTimes[kBootStageCount];
+
+void BootProfilerMark(BootStage stage)
+{
+    // Zero means not reached, so nothing can be recorded at exactly 0 ms.
+    //
+    uint32_t now = (uint32_t)(esp_timer_get_time() / 1000);
+
+    if (now == 0)
+    {
+        now = 1;
+    }
+
+    uint32_t expected = 0;
+
+    if (sStageTimes[(uint8_t)stage].compare_exchange_strong(expected, now))
+    {
+        ESP_LOGI(TAG, "%s at %lu ms", BootProfilerGetStageName(stage), now);
+    }
+}
+
+uint32_t BootProfilerGetTime(BootStage stage)
+{
+    return sStageTimes[(uint8_t)stage].load();
+}
+
+const char *BootProfilerGetStageName(BootStage stage)
+{
+    switch (stage)
+    {
+    case BootStage::kAppMain:
+        return "app_main";
+    case BootStage::kNvsReady:
+        return "nvs ready";
+    case BootStage::kEndpointsCreated:
+        return "endpoints created";
+    case BootStage::kManagerReady:
+        return "manager ready";
+    case BootStage::kDriverReady:
+        return "buttons ready";
+    case BootStage::kMatterStarted:
+        return "matter started";
+    case BootStage::kDisplayReady:
+        return "display ready";
+    case BootStage::kServerReady:
+        return "server ready";
+    case BootStage::kCommissionable:
+        return "commissionable";
+    case BootStage::kFirstReport:
+        return "first report";
+    default:
+        return "unknown";
+    }
+}
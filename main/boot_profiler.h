@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+
+// Records when each stage of boot is reached, so the time until the device can
+// be commissioned, and until it first reports, can be measured on real boards.
+//
+// Stages are listed in the order they are normally reached, but the display is
+// brought up by the dishwasher task alongside Matter, so it can land anywhere
+// after kManagerReady.
+//
+enum class BootStage : uint8_t
+{
+    kAppMain,
+    kNvsReady,
+    kEndpointsCreated,
+    kManagerReady,
+    kDriverReady,
+    kMatterStarted,
+    kDisplayReady,
+    kServerReady,
+    kCommissionable,
+    kFirstReport,
+};
+
+constexpr uint8_t kBootStageCount = 10;
+
+// Records the current time against a stage, the first time it is reached.
+// Safe to call from any task.
+//
+void BootProfilerMark(BootStage stage);
+
+// Milliseconds since boot at which the stage was reached, or 0 if it hasn't been.
+//
+uint32_t BootProfilerGetTime(BootStage stage);
+
+const char *BootProfilerGetStageName(BootStage stage);
@@ -0,0 +1,79 @@
+#include "countdown_reporter.h"
+
+CountdownReporter::CountdownReporter(uint32_t intervalSeconds, uint32_t jumpThresholdSeconds)
+    : mIntervalMs((uint64_t)intervalSeconds * 1000), mJumpThreshold(jumpThresholdSeconds)
+{
+}
+
+bool CountdownReporter::Evaluate(uint64_t nowMs, uint32_t countdown, bool isCounting, bool isForced)
+{
+    bool is_due = isForced;
+
+    // Starting and stopping.
+    //
+    if ((countdown == 0) != (mLastCountdown == 0))
+    {
+        is_due = true;
+    }
+
+    // Where the countdown would be if nothing but time had changed it since the
+    // last report.
+    //
+    uint32_t expected = mLastCountdown;
+
+    if (mWasCounting)
+    {
+        uint32_t elapsed = (uint32_t)((nowMs - mLastReportMs) / 1000);
+        expected = elapsed < mLastCountdown ? mLastCountdown - elapsed : 0;
+    }
+
+    uint32_t drift = countdown > expected ? countdown - expected : expected - countdown;
+
+    if (drift > mJumpThreshold)
+    {
+        is_due = true;
+    }
+
+    if (!is_due && countdown != mLastCountdown)
+    {
+        if (mIntervalMs == 0 || nowMs - mLastReportMs < mIntervalMs)
+        {
+            mSuppressedCount++;
+            return false;
+        }
+
+        is_due = true;
+    }
+
+    if (!is_due)
+    {
+        return false;
+    }
+
+    mLastCountdown = countdown;
+    mLastReportMs = nowMs;
+    mWasCounting = isCounting && countdown > 0;
+    mReportCount++;
+
+    return true;
+}
+
+uint64_t CountdownReporter::GetNextDeadline() const
+{
+    if (!mWasCounting || mIntervalMs == 0)
+    {
+        return kNoDeadline;
+    }
+
+    return mLastReportMs + mIntervalMs;
+}
+
+uint32_t CountdownReporter::GetReportCount() const
+{
+    return mReportCount;
+}
+
+uint32_t CountdownReporter::GetSuppressedCount() const
+{
+    return mSuppressedCount;
+}
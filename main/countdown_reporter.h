@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+
+// Decides when a change to the CountdownTime attribute is worth reporting.
+//
+// The countdown changes every second, but a controller can work that out for
+// itself. Following the quieting rules the Matter spec gives CountdownTime, a
+// report is only made when the countdown starts or stops, when it moves by more
+// than the jump threshold away from where one second per second would have
+// put it, or when the operational state changes. Otherwise a report is made at
+// most once per interval, so subscribers don't drift too far.
+//
+// Like ProgramEngine nothing in here ticks. The caller evaluates the countdown
+// whenever it has handled events, and wakes up at GetNextDeadline() to make
+// the next periodic report.
+//
+class CountdownReporter
+{
+public:
+    static constexpr uint64_t kNoDeadline = UINT64_MAX;
+
+    // An interval of zero turns periodic reports off.
+    //
+    CountdownReporter(uint32_t intervalSeconds, uint32_t jumpThresholdSeconds);
+
+    // Returns true if the countdown should be reported now. isCounting is true
+    // while the countdown is moving down one second per second. isForced is true
+    // when something the countdown depends on, such as the operational state,
+    // has changed.
+    //
+    bool Evaluate(uint64_t nowMs, uint32_t countdown, bool isCounting, bool isForced);
+
+    // When the next periodic report is due, for as long as the countdown is moving.
+    //
+    uint64_t GetNextDeadline() const;
+
+    uint32_t GetReportCount() const;
+    uint32_t GetSuppressedCount() const;
+
+private:
+    uint64_t mIntervalMs;
+    uint32_t mJumpThreshold;
+
+    uint32_t mLastCountdown = 0;
+    uint64_t mLastReportMs = 0;
+    bool mWasCounting = false;
+
+    uint32_t mReportCount = 0;
+    uint32_t mSuppressedCount = 0;
+};
@@ -0,0 +1,231 @@
+#include "dishwasher_benchmark.h"
+
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "dishwasher_manager.h"
+#include "status_display.h"
+#include "forecast_builder.h"
+#include "start_scheduler.h"
+#include "wash_programs.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_attr.h"
+#include "esp_cpu.h"
+#include "esp_heap_caps.h"
+#include "esp_rom_sys.h"
+#include "sdkconfig.h"
+#endif
+
+static ForecastPlan sBenchmarkForecast;
+static TariffCurve sBenchmarkTariff;
+
+static void BenchmarkUpdateDishwasherDisplay()
+{
+    DishwasherMgr().UpdateDishwasherDisplay();
+}
+
+static void BenchmarkProgressProgram()
+{
+    DishwasherMgr().ProgressProgram();
+}
+
+static void BenchmarkBuildForecast()
+{
+    // The same work StartProgram does for the longest program.
+    //
+    BuildForecast(GetWashProgram(1), 1760000000, sBenchmarkForecast);
+}
+
+// A full day of 15 minute prices, searched across the whole day.
+//
+static void BenchmarkFindCheapestStart()
+{
+    uint32_t start_time;
+
+    FindCheapestStart(sBenchmarkForecast, sBenchmarkTariff, sBenchmarkTariff.startTime, sBenchmarkTariff.startTime + 86400, start_time);
+}
+
+// What SetForecast does each time the forecast changes.
+//
+static void BenchmarkChooseForecastResolution()
+{
+    ChooseForecastResolution(sBenchmarkForecast, CONFIG_DISHWASHER_FORECAST_SIZE_BUDGET);
+}
+
+static void BenchmarkStatusDisplayRunning()
+{
+    StatusViewModel view = {};
+
+    view.isProgramSelected = true;
+    view.state = RUNNING;
+    view.mode = 1;
+    view.hasPhase = true;
+    view.phase = to_underlying(WashPhase::kMainWash);
+    view.timeRemaining = 9000;
+
+    StatusDisplayMgr().UpdateDisplay(view);
+}
+
+// A new second each call, which is what the display refresh sees while a program runs.
+//
+static void BenchmarkStatusDisplayCountdown()
+{
+    static uint32_t time_remaining = 9000;
+
+    StatusViewModel view = {};
+
+    view.isProgramSelected = true;
+    view.state = RUNNING;
+    view.mode = 1;
+    view.hasPhase = true;
+    view.phase = to_underlying(WashPhase::kMainWash);
+    view.timeRemaining = time_remaining--;
+
+    StatusDisplayMgr().UpdateDisplay(view);
+}
+
+static void BenchmarkStatusDisplayDelayedStart()
+{
+    StatusViewModel view = {};
+
+    view.hasOptedIn = true;
+    view.isProgramSelected = true;
+    view.startsIn = 60;
+    view.state = STOPPED;
+    view.mode = 1;
+
+    StatusDisplayMgr().UpdateDisplay(view);
+}
+
+static BenchmarkResult RunBenchmark(const char *name, void (*function)(), uint32_t iterations)
+{
+    BenchmarkResult result = {name, iterations, 0, UINT32_MAX, 0, 0, 0};
+
+    // One untimed call first, so one-off work (like LVGL allocating a style) isn't counted.
+    //
+    function();
+
+    uint64_t allocations = BenchmarkGetAllocationCount();
+    int64_t allocated_bytes = BenchmarkGetAllocatedBytes();
+
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        uint32_t start = BenchmarkGetTicks();
+        function();
+        uint32_t ticks = BenchmarkGetTicks() - start;
+
+        result.totalTicks += ticks;
+
+        if (ticks < result.minTicks)
+        {
+            result.minTicks = ticks;
+        }
+
+        if (ticks > result.maxTicks)
+        {
+            result.maxTicks = ticks;
+        }
+    }
+
+    result.allocations = BenchmarkGetAllocationCount() - allocations;
+    result.retainedBytes = BenchmarkGetAllocatedBytes() - allocated_bytes;
+
+    return result;
+}
+
+static void PrintResult(const BenchmarkResult &result)
+{
+    double ticks_per_us = BenchmarkGetTicksPerMicrosecond();
+
+    printf("%-38s %8" PRIu32 " %10.2f %10.2f %10.2f %12.2f %12" PRId64 "\n",
+           result.name,
+           result.iterations,
+           result.totalTicks / ticks_per_us / result.iterations,
+           result.minTicks / ticks_per_us,
+           result.maxTicks / ticks_per_us,
+           (double)result.allocations / result.iterations,
+           result.retainedBytes);
+}
+
+void RunDishwasherBenchmarks(uint32_t iterations)
+{
+    DishwasherManager &dishwasher = DishwasherMgr();
+
+    if (iterations == 0)
+    {
+        return;
+    }
+
+    dishwasher.TurnOnPower();
+
+    printf("%-38s %8s %10s %10s %10s %12s %12s\n", "benchmark", "calls", "mean us", "min us", "max us", "allocs/call", "retained B");
+
+    PrintResult(RunBenchmark("BuildForecast", BenchmarkBuildForecast, iterations));
+
+    sBenchmarkTariff.startTime = 1760000000;
+    sBenchmarkTariff.bucketDuration = 15 * 60;
+    sBenchmarkTariff.bucketCount = kMaxTariffBuckets;
+
+    for (uint8_t i = 0; i < kMaxTariffBuckets; i++)
+    {
+        sBenchmarkTariff.costs[i] = (i * 37) % 50;
+    }
+
+    PrintResult(RunBenchmark("FindCheapestStart", BenchmarkFindCheapestStart, iterations));
+    PrintResult(RunBenchmark("ChooseForecastResolution", BenchmarkChooseForecastResolution, iterations));
+    PrintResult(RunBenchmark("StatusDisplay::UpdateDisplay", BenchmarkStatusDisplayRunning, iterations));
+    PrintResult(RunBenchmark("StatusDisplay::UpdateDisplay (count)", BenchmarkStatusDisplayCountdown, iterations));
+    PrintResult(RunBenchmark("StatusDisplay::UpdateDisplay (delay)", BenchmarkStatusDisplayDelayedStart, iterations));
+
+    // The rest run against a program in progress.
+    //
+    dishwasher.UpdateMode(1);
+    dishwasher.StartProgram();
+
+    PrintResult(RunBenchmark("UpdateDishwasherDisplay", BenchmarkUpdateDishwasherDisplay, iterations));
+    PrintResult(RunBenchmark("ProgressProgram", BenchmarkProgressProgram, iterations));
+
+    dishwasher.StopProgram();
+    dishwasher.UpdateDishwasherDisplay();
+}
+
+#ifdef ESP_PLATFORM
+
+// Allocations are counted with the heap hooks (CONFIG_HEAP_USE_HOOKS), which
+// see every task, so anything else running at the time shows up as noise.
+//
+static volatile uint32_t sAllocationCount = 0;
+
+#if CONFIG_HEAP_USE_HOOKS
+extern "C" void IRAM_ATTR esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t caps)
+{
+    sAllocationCount++;
+}
+
+extern "C" void IRAM_ATTR esp_heap_trace_free_hook(void *ptr)
+{
+}
+#endif
+
+uint32_t BenchmarkGetTicks()
+{
+    return esp_cpu_get_cycle_count();
+}
+
+uint32_t BenchmarkGetTicksPerMicrosecond()
+{
+    return esp_rom_get_cpu_ticks_per_us();
+}
+
+uint64_t BenchmarkGetAllocationCount()
+{
+    return sAllocationCount;
+}
+
+int64_t BenchmarkGetAllocatedBytes()
+{
+    return -(int64_t)heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+}
+
+#endif
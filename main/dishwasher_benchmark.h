@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+
+// Micro-benchmarks for the code that runs on every program tick and display
+// refresh.
+//
+// The same suite runs on the host (host/dishwasher_bench) and on the device,
+// where it is enabled with CONFIG_DISHWASHER_BENCHMARK and runs once at boot.
+// Each benchmark reports its latency per call and how many heap allocations
+// it makes, along with any heap it leaves behind.
+//
+
+struct BenchmarkResult
+{
+    const char *name;
+    uint32_t iterations;
+    uint64_t totalTicks;
+    uint32_t minTicks;
+    uint32_t maxTicks;
+    uint64_t allocations;
+    int64_t retainedBytes;
+};
+
+// Runs every benchmark against DishwasherMgr(), which must already be
+// initialised, and prints a table of the results. The dishwasher is left
+// powered on with no program selected.
+//
+// The benchmarks call the manager and the display directly, so they must run
+// on the dispatcher. On the device they are posted as a
+// DishwasherEventType::kRunBenchmarks event, which is handled after the display
+// has been brought up. Other events wait until the benchmarks finish, and
+// events that can't wait are dropped, so only the results are to be trusted.
+//
+void RunDishwasherBenchmarks(uint32_t iterations);
+
+// Provided by the platform. Ticks come from a free running counter (CPU
+// cycles on the device), and the allocation figures cover the whole heap.
+//
+uint32_t BenchmarkGetTicks();
+uint32_t BenchmarkGetTicksPerMicrosecond();
+uint64_t BenchmarkGetAllocationCount();
+int64_t BenchmarkGetAllocatedBytes();
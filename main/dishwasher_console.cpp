@@ -0,0 +1,313 @@
+#include "dishwasher_console.h"
+
+#include "power_manager.h"
+#include "boot_profiler.h"
+#include "telemetry.h"
+#include "dishwasher_manager.h"
+#include "dishwasher_matter.h"
+#include "start_scheduler.h"
+#include "app_priv.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <esp_log.h>
+#include <esp_matter_console.h>
+
+using namespace esp_matter::console;
+
+// The log tags that make up each subsystem in Dishwasher > Logging.
+//
+struct LogSubsystem
+{
+    const char *name;
+    const char *tags[6];
+};
+
+static const LogSubsystem kLogSubsystems[] = {
+    {"program", {"dishwasher_manager", "power_manager", "dishwasher_events", "program_store", "boot_profiler", "telemetry"}},
+    {"display", {"status_display"}},
+    {"matter", {"app_driver", "dishwasher_matter"}},
+    {"input", {"mode_selector"}},
+};
+
+static const char *kLogLevelNames[] = {"none", "error", "warn", "info", "debug", "verbose"};
+
+static engine sDishwasherConsole;
+
+static esp_err_t PrintLogLevels()
+{
+    for (const LogSubsystem &subsystem : kLogSubsystems)
+    {
+        printf("%-8s %s\n", subsystem.name, kLogLevelNames[esp_log_level_get(subsystem.tags[0])]);
+    }
+
+    return ESP_OK;
+}
+
+static esp_err_t LogHandler(int argc, char **argv)
+{
+    if (argc == 0)
+    {
+        return PrintLogLevels();
+    }
+
+    if (argc != 2)
+    {
+        printf("Usage: dishwasher log <program|display|matter|input|all> <none|error|warn|info|debug|verbose>\n");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    int level = -1;
+
+    for (int i = 0; i < sizeof(kLogLevelNames) / sizeof(kLogLevelNames[0]); i++)
+    {
+        if (strcmp(argv[1], kLogLevelNames[i]) == 0)
+        {
+            level = i;
+        }
+    }
+
+    if (level < 0)
+    {
+        printf("Unknown log level: %s\n", argv[1]);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    bool is_all = strcmp(argv[0], "all") == 0;
+    bool has_matched = false;
+
+    for (const LogSubsystem &subsystem : kLogSubsystems)
+    {
+        if (!is_all && strcmp(argv[0], subsystem.name) != 0)
+        {
+            continue;
+        }
+
+        for (const char *tag : subsystem.tags)
+        {
+            if (tag != nullptr)
+            {
+                esp_log_level_set(tag, (esp_log_level_t)level);
+            }
+        }
+
+        has_matched = true;
+    }
+
+    if (!has_matched)
+    {
+        printf("Unknown subsystem: %s\n", argv[0]);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Anything above the level the subsystem was built with still prints nothing.
+    //
+    return PrintLogLevels();
+}
+
+static esp_err_t PowerHandler(int argc, char **argv)
+{
+    printf("Power state: %s\n", PowerManager::GetStateName(PowerMgr().GetState()));
+
+    for (uint8_t i = 0; i < kPowerStateCount; i++)
+    {
+        PowerState state = (PowerState)i;
+        uint64_t time = PowerMgr().GetTimeInState(state);
+
+        printf("%-12s %" PRIu64 ".%03" PRIu64 " s\n", PowerManager::GetStateName(state), time / 1000, time % 1000);
+    }
+
+    return ESP_OK;
+}
+
+static esp_err_t BootHandler(int argc, char **argv)
+{
+    uint32_t previous = 0;
+
+    for (uint8_t i = 0; i < kBootStageCount; i++)
+    {
+        BootStage stage = (BootStage)i;
+        uint32_t time = BootProfilerGetTime(stage);
+
+        if (time == 0)
+        {
+            printf("%-18s -\n", BootProfilerGetStageName(stage));
+            continue;
+        }
+
+        printf("%-18s %6lu ms (+%lu)\n", BootProfilerGetStageName(stage), time, time > previous ? time - previous : 0);
+        previous = time;
+    }
+
+    return ESP_OK;
+}
+
+// Takes a sample now, so the newest row is current, then prints every sample
+// kept, oldest first, and each watched task's stack.
+//
+static esp_err_t StatsHandler(int argc, char **argv)
+{
+    TelemetryMgr().Sample();
+
+    uint8_t sample_count = TelemetryMgr().GetSampleCount();
+    TelemetrySample oldest = TelemetryMgr().GetSample(0);
+    TelemetrySample newest = TelemetryMgr().GetSample(sample_count - 1);
+
+    printf("%8s %8s %8s %8s\n", "uptime", "free", "largest", "min free");
+
+    for (uint8_t i = 0; i < sample_count; i++)
+    {
+        TelemetrySample sample = TelemetryMgr().GetSample(i);
+
+        printf("%6lu s %8lu %8lu %8lu\n", sample.uptime, sample.freeHeap, sample.largestFreeBlock, sample.minimumFreeHeap);
+    }
+
+    // A high-water mark only ever goes down, so a task whose free stack is
+    // below the oldest sample's reached a new peak within the window.
+    //
+    printf("\n%-20s %6s %6s %6s %6s\n", "task", "stack", "peak", "free", "oldest");
+
+    for (uint8_t i = 0; i < TelemetryMgr().GetTaskCount(); i++)
+    {
+        uint32_t stack_size = TelemetryMgr().GetTaskStackSize(i);
+
+        if (newest.stackHighWater[i] == 0)
+        {
+            printf("%-20s %6lu %6s %6s %6s\n", TelemetryMgr().GetTaskName(i), stack_size, "-", "-", "-");
+            continue;
+        }
+
+        char oldest_free[12] = "-";
+
+        if (oldest.stackHighWater[i] != 0)
+        {
+            snprintf(oldest_free, sizeof(oldest_free), "%lu", oldest.stackHighWater[i]);
+        }
+
+        printf("%-20s %6lu %6lu %6lu %6s\n", TelemetryMgr().GetTaskName(i), stack_size, stack_size - newest.stackHighWater[i], newest.stackHighWater[i], oldest_free);
+    }
+
+    return ESP_OK;
+}
+
+// The counters are only written on the Matter thread, so they may be a
+// publish behind.
+//
+static esp_err_t ForecastHandler(int argc, char **argv)
+{
+    printf("forecast store %u bytes (%u slots in each of 2 buffers)\n", (unsigned)ForecastStore::GetFootprint(), kMaxPublishedSlots);
+
+    for (uint8_t i = 0; i < GetDishwasherEndpointCount(); i++)
+    {
+        DishwasherEndpoint &dishwasher = GetDishwasherEndpoint(i);
+
+        printf("endpoint %d forecasts published %lu\n", dishwasher.energyEndpointId, dishwasher.energyDelegate.GetForecastStore().GetSwapCount());
+    }
+
+    return ESP_OK;
+}
+
+// Sets the tariff the scheduler picks start times from, starting now.
+//
+static esp_err_t TariffHandler(int argc, char **argv)
+{
+    if (argc < 2 || argc - 1 > kMaxTariffBuckets)
+    {
+        printf("Usage: dishwasher tariff <bucket minutes> <cost> [<cost> ...] (up to %u costs)\n", kMaxTariffBuckets);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    static TariffCurve tariff;
+
+    tariff = TariffCurve();
+    tariff.startTime = MatterGetEpochTime();
+    tariff.bucketDuration = strtoul(argv[0], NULL, 10) * 60;
+    tariff.bucketCount = argc - 1;
+
+    if (tariff.bucketDuration == 0)
+    {
+        printf("The bucket length must be at least a minute\n");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    for (int i = 1; i < argc; i++)
+    {
+        tariff.costs[i - 1] = strtol(argv[i], NULL, 10);
+    }
+
+    if (!DishwasherMgr().PostTariff(tariff))
+    {
+        printf("The last tariff hasn't been taken yet, try again\n");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    printf("Tariff of %u buckets of %lu minutes set\n", tariff.bucketCount, tariff.bucketDuration / 60);
+
+    return ESP_OK;
+}
+
+static esp_err_t DishwasherDispatch(int argc, char **argv)
+{
+    if (argc <= 0)
+    {
+        printf("Usage: dishwasher <command> [arguments]\n");
+        printf("  log    Show or change the log level of a subsystem\n");
+        printf("  power  Show the time spent in each power state\n");
+        printf("  boot   Show when each stage of boot was reached\n");
+        printf("  tariff Set the energy cost the start time is scheduled against\n");
+        printf("  forecast Show the memory used by the published forecast\n");
+        printf("  stats  Show the free heap and the stack high-water mark of each task\n");
+        return ESP_OK;
+    }
+
+    return sDishwasherConsole.exec_command(argc, argv);
+}
+
+esp_err_t DishwasherConsoleRegisterCommands()
+{
+    static const command_t dishwasher_command = {
+        .name = "dishwasher",
+        .description = "Dishwasher diagnostics. Usage: matter esp dishwasher <command>",
+        .handler = DishwasherDispatch,
+    };
+
+    static const command_t dishwasher_commands[] = {
+        {
+            .name = "log",
+            .description = "Show or change the log level of a subsystem. Usage: dishwasher log [<subsystem> <level>]",
+            .handler = LogHandler,
+        },
+        {
+            .name = "power",
+            .description = "Show the time spent in each power state. Usage: dishwasher power",
+            .handler = PowerHandler,
+        },
+        {
+            .name = "boot",
+            .description = "Show when each stage of boot was reached. Usage: dishwasher boot",
+            .handler = BootHandler,
+        },
+        {
+            .name = "tariff",
+            .description = "Set the energy cost the start time is scheduled against. Usage: dishwasher tariff <bucket minutes> <cost> [<cost> ...]",
+            .handler = TariffHandler,
+        },
+        {
+            .name = "forecast",
+            .description = "Show the memory used by the published forecast. Usage: dishwasher forecast",
+            .handler = ForecastHandler,
+        },
+        {
+            .name = "stats",
+            .description = "Show the free heap and the stack high-water mark of each task. Usage: dishwasher stats",
+            .handler = StatsHandler,
+        },
+    };
+
+    sDishwasherConsole.register_commands(dishwasher_commands, sizeof(dishwasher_commands) / sizeof(command_t));
+
+    return add_commands(&dishwasher_command, 1);
+}
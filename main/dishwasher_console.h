@@ -0,0 +1,15 @@
+#pragma once
+
+#include <esp_err.h>
+
+// Registers the "matter esp dishwasher" console commands.
+//
+//   matter esp dishwasher log                      Show each subsystem's runtime log level.
+//   matter esp dishwasher log <subsystem> <level>  Change it, for a subsystem or "all".
+//   matter esp dishwasher power                    Show the time spent in each power state.
+//   matter esp dishwasher boot                     Show when each stage of boot was reached.
+//   matter esp dishwasher tariff <minutes> <cost>  Set the cost of energy for each bucket from now.
+//   matter esp dishwasher forecast                 Show the memory used by the published forecast.
+//   matter esp dishwasher stats                    Show the free heap and each task's stack high-water mark.
+//
+esp_err_t DishwasherConsoleRegisterCommands();
@@ -0,0 +1,105 @@
+#define DISHWASHER_LOG_LEVEL CONFIG_DISHWASHER_LOG_LEVEL_PROGRAM
+#include "dishwasher_log.h"
+
+#include "dishwasher_events.h"
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+
+#include "dishwasher_manager.h"
+#include "telemetry.h"
+
+static const char *TAG = "dishwasher_events";
+
+#define DISHWASHER_EVENT_QUEUE_LENGTH 32
+#define DISHWASHER_TASK_STACK_SIZE 6144
+
+// A poster waits this long for space before the event is dropped. The
+// dispatcher never posts, so a full queue only ever means it is busy.
+//
+#define DISHWASHER_EVENT_POST_TIMEOUT_MS 100
+
+static QueueHandle_t sEventQueue = NULL;
+static volatile uint32_t sDroppedEvents = 0;
+
+// Handles one event, then everything else that has queued up behind it, before
+// each manager that had events pushes the results out. A burst of encoder steps
+// or timer expiries ends in a single display update.
+//
+static void DishwasherDispatcherTask(void *arg)
+{
+    DishwasherEvent event;
+
+    while (1)
+    {
+        if (xQueueReceive(sEventQueue, &event, portMAX_DELAY) != pdTRUE)
+        {
+            continue;
+        }
+
+        DishwasherManager *to_finish = nullptr;
+
+        do
+        {
+            event.manager->ScheduleFinish(to_finish);
+            event.manager->HandleEvent(event);
+        } while (xQueueReceive(sEventQueue, &event, 0) == pdTRUE);
+
+        DishwasherManager::FinishScheduled(to_finish);
+    }
+}
+
+esp_err_t DishwasherEventsInit()
+{
+    if (sEventQueue != NULL)
+    {
+        return ESP_OK;
+    }
+
+    sEventQueue = xQueueCreate(DISHWASHER_EVENT_QUEUE_LENGTH, sizeof(DishwasherEvent));
+
+    if (sEventQueue == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    // The dispatcher also brings up the display and LVGL, see DishwasherEventType::kStartUp.
+    //
+    if (xTaskCreate(DishwasherDispatcherTask, "dishwasher", DISHWASHER_TASK_STACK_SIZE, NULL, tskIDLE_PRIORITY + 2, NULL) != pdPASS)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    TelemetryMgr().WatchTask("dishwasher", DISHWASHER_TASK_STACK_SIZE);
+
+    return ESP_OK;
+}
+
+bool DishwasherPostEvent(DishwasherManager &manager, DishwasherEventType type, uint32_t value)
+{
+    DishwasherEvent event = {
+        .type = type,
+        .value = value,
+        .manager = &manager,
+    };
+
+    if (xQueueSend(sEventQueue, &event, pdMS_TO_TICKS(DISHWASHER_EVENT_POST_TIMEOUT_MS)) != pdTRUE)
+    {
+        sDroppedEvents = sDroppedEvents + 1;
+        ESP_LOGW(TAG, "Event queue full, dropped event %d", (int)type);
+        return false;
+    }
+
+    return true;
+}
+
+bool DishwasherPostEvent(DishwasherEventType type, uint32_t value)
+{
+    return DishwasherPostEvent(DishwasherMgr(), type, value);
+}
+
+uint32_t DishwasherGetDroppedEvents()
+{
+    return sDroppedEvents;
+}
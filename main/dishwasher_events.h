@@ -0,0 +1,143 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <esp_err.h>
+
+#include <atomic>
+
+class DishwasherManager;
+
+// Every change to DishwasherManager arrives as one of these events.
+//
+// Buttons, the encoder, timers and the Matter thread only post events. A
+// single dispatcher handles them in order, so the manager's state is only
+// ever touched from one task and needs no locking. That holds however many
+// managers there are, as they all share the one dispatcher.
+//
+enum class DishwasherEventType : uint8_t
+{
+    // Posted once by DishwasherManager::Init, so the display and encoder are
+    // brought up by the dispatcher while app_main carries on starting Matter.
+    //
+    kStartUp,
+
+    // Front panel.
+    //
+    kOnOffClicked,
+    kOnOffLongPressed,
+    kStartClicked,
+    kWheelClicked,
+    kEncoderNext,
+    kEncoderPrevious,
+
+    // Matter. value holds the mode, start time or on/off state where there is one.
+    //
+    kSetPower,
+    kStartProgram,
+    kStopProgram,
+    kPauseProgram,
+    kResumeProgram,
+    kChangeMode,
+    kAdjustStartTime,
+    kTariffChanged,
+    kModifyForecast,
+    kPowerAdjust,
+    kCancelPowerAdjust,
+    kEnergyPause,
+    kEnergyResume,
+
+    // Timers.
+    //
+    kProgramTimer,
+    kDisplayRefresh,
+    kDisplaySleep,
+
+    // The Matter thread has applied the last MatterPublishChanges, or the
+    // server has started and can take changes.
+    //
+    kMatterPublished,
+
+    // The wall clock has been set by SNTP, or set again.
+    //
+    kTimeSet,
+
+    // Diagnostics. value holds the number of calls each benchmark makes.
+    //
+    kRunBenchmarks,
+};
+
+struct DishwasherEvent
+{
+    DishwasherEventType type;
+    uint32_t value;
+    DishwasherManager *manager;
+};
+
+// Creates the queue and starts the dispatcher. On the device that is a task
+// that blocks on the queue; on the host events are handled as they are posted.
+// Only the first call does anything, so every manager can make it.
+//
+esp_err_t DishwasherEventsInit();
+
+// Queues an event for the given manager. Safe to call from any task, but not
+// from an ISR. Returns false, and counts the event as dropped, if the queue
+// stays full.
+//
+bool DishwasherPostEvent(DishwasherManager &manager, DishwasherEventType type, uint32_t value = 0);
+
+// Queues an event for DishwasherMgr(), the dishwasher with the front panel.
+//
+bool DishwasherPostEvent(DishwasherEventType type, uint32_t value = 0);
+
+uint32_t DishwasherGetDroppedEvents();
+
+// Carries a request too big for DishwasherEvent::value, such as a tariff, over
+// to the dispatcher. It holds one request at a time: Post fails until the
+// dispatcher has taken the last one, which the caller can report as busy.
+//
+template <typename T>
+class EventMailbox
+{
+public:
+    // Called from any task but an ISR.
+    //
+    bool Post(DishwasherManager &manager, DishwasherEventType type, const T &value)
+    {
+        bool expected = false;
+
+        if (!mIsFull.compare_exchange_strong(expected, true))
+        {
+            return false;
+        }
+
+        mValue = value;
+
+        if (!DishwasherPostEvent(manager, type))
+        {
+            mIsFull.store(false);
+            return false;
+        }
+
+        return true;
+    }
+
+    // Called by the dispatcher when it handles the event.
+    //
+    bool Take(T &value)
+    {
+        if (!mIsFull.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+
+        value = mValue;
+        mIsFull.store(false, std::memory_order_release);
+
+        return true;
+    }
+
+private:
+    T mValue;
+    std::atomic<bool> mIsFull{false};
+};
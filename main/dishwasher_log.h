@@ -0,0 +1,31 @@
+#pragma once
+
+// Per-subsystem compile time log levels, set under Dishwasher > Logging in menuconfig.
+//
+// A source file names its subsystem level and includes this before anything
+// that might pull in esp_log.h:
+//
+//   #define DISHWASHER_LOG_LEVEL CONFIG_DISHWASHER_LOG_LEVEL_DISPLAY
+//   #include "dishwasher_log.h"
+//
+// Anything more detailed than that level compiles to nothing. What is compiled
+// in is still filtered at runtime by the tag's level, which the
+// "matter esp dishwasher log" console command changes.
+//
+// Per tick logging uses ESP_LOGV, and per event logging ESP_LOGD, so neither
+// reaches the UART unless asked for.
+//
+
+#include "sdkconfig.h"
+
+#ifndef DISHWASHER_LOG_LEVEL
+#error "Define DISHWASHER_LOG_LEVEL before including dishwasher_log.h"
+#endif
+
+#ifdef LOG_LOCAL_LEVEL
+#error "dishwasher_log.h must be included before esp_log.h"
+#endif
+
+#define LOG_LOCAL_LEVEL DISHWASHER_LOG_LEVEL
+
+#include "esp_log.h"
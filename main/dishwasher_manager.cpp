@@ -1,13 +1,21 @@
-#include "dishwasher_manager.h"
-
-#include "esp_log.h"
+#define DISHWASHER_LOG_LEVEL CONFIG_DISHWASHER_LOG_LEVEL_PROGRAM
+#include "dishwasher_log.h"
 
-#include <app/clusters/operational-state-server/operational-state-server.h>
-#include <app/clusters/mode-base-server/mode-base-server.h>
+#include "dishwasher_manager.h"
 
 #include "status_display.h"
 #include "mode_selector.h"
-#include "app_priv.h"
+#include "wash_programs.h"
+#include "forecast_builder.h"
+#include "dishwasher_matter.h"
+#include "power_manager.h"
+#include "program_store.h"
+#include "boot_profiler.h"
+#include "start_scheduler.h"
+
+#if CONFIG_DISHWASHER_BENCHMARK
+#include "dishwasher_benchmark.h"
+#endif
 
 #include <inttypes.h>
 
@@ -18,286 +26,1490 @@ using namespace chip::app;
 using namespace chip::app::Clusters;
 using namespace chip::app::Clusters::OperationalState;
 
-DishwasherManager DishwasherManager::sDishwasher;
+static_assert(kMaxWashSteps <= ProgramEngine::kMaxSteps, "ProgramEngine cannot hold every step of a wash program");
+
+DishwasherManager DishwasherManager::sDishwasher({
+    .checkpointKey = "program",
+    .hasFrontPanel = true,
+});
+
+// When opted in, a program never starts sooner than this, so an energy manager
+// has a chance to move it.
+//
+static constexpr uint32_t kMinStartDelay = 60;
+
+// The shortest PowerAdjustRequest we advertise. Anything shorter isn't worth
+// stretching a step for.
+//
+static constexpr uint32_t kMinPowerAdjustDuration = 60;
 
-static void ProgramTick(void *arg)
+// The running program only needs attention at its next deadline (delayed start
+// expiry, phase boundary or program end), so a one-shot timer is armed for that.
+//
+// The display refresh is separate and only runs while a countdown is visible.
+//
+// Without input the display goes to sleep, unless a program is running, so the
+// chip can light sleep between these timers through a delayed start.
+//
+// The timers run on the esp_timer task, so they only post an event to the
+// manager that owns them.
+//
+static void ProgramTimerCallback(void *arg)
+{
+    DishwasherPostEvent(*static_cast<DishwasherManager *>(arg), DishwasherEventType::kProgramTimer);
+}
+
+static void DisplayRefreshTimerCallback(void *arg)
+{
+    DishwasherPostEvent(*static_cast<DishwasherManager *>(arg), DishwasherEventType::kDisplayRefresh);
+}
+
+static void DisplaySleepTimerCallback(void *arg)
+{
+    DishwasherPostEvent(*static_cast<DishwasherManager *>(arg), DishwasherEventType::kDisplaySleep);
+}
+
+static uint64_t NowMs()
+{
+    return esp_timer_get_time() / 1000;
+}
+
+DishwasherManager::DishwasherManager(const DishwasherConfig &config) : mHasFrontPanel(config.hasFrontPanel), mProgramStore(config.checkpointKey)
 {
-    while (1)
-    {
-        DishwasherMgr().ProgressProgram();
-        vTaskDelay(1000 / portTICK_PERIOD_MS);
-    }
 }
 
 esp_err_t DishwasherManager::Init()
 {
     ESP_LOGI(TAG, "Initializing DishwasherManager");
-    StatusDisplayMgr().Init();
-    ModeSelectorMgr().Init();
 
-    xTaskCreate(ProgramTick, "ProgramTick", 4096, NULL, tskIDLE_PRIORITY, NULL);
+    if (mHasFrontPanel)
+    {
+        PowerMgr().Init();
+    }
+
+    esp_timer_create_args_t program_timer_args = {
+        .callback = ProgramTimerCallback,
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "program",
+        .skip_unhandled_events = true,
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&program_timer_args, &mProgramTimer));
+
+    esp_timer_create_args_t display_refresh_timer_args = {
+        .callback = DisplayRefreshTimerCallback,
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "display_refresh",
+        .skip_unhandled_events = true,
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&display_refresh_timer_args, &mDisplayRefreshTimer));
+
+    esp_timer_create_args_t display_sleep_timer_args = {
+        .callback = DisplaySleepTimerCallback,
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "display_sleep",
+        .skip_unhandled_events = true,
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&display_sleep_timer_args, &mDisplaySleepTimer));
+
+    PublishSnapshot();
+
+    esp_err_t err = DishwasherEventsInit();
+
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+
+    // The display and encoder take a while to bring up, so that is left to the
+    // dispatcher and doesn't hold up Matter. Nothing else is handled until it's done.
+    //
+    DishwasherPostEvent(*this, DishwasherEventType::kStartUp);
 
     return ESP_OK;
 }
 
-void DishwasherManager::PresentReset()
+void DishwasherManager::StartUp()
 {
-    mIsShowingReset = true;
-    StatusDisplayMgr().ShowResetOptions();
+    if (mHasFrontPanel)
+    {
+        StatusDisplayMgr().Init();
+        ModeSelectorMgr().Init();
+
+        // The dishwasher starts off, so the display and encoder start asleep, unless
+        // a program was interrupted by a reboot and picks up where it left off.
+        //
+        StatusDisplayMgr().TurnOff();
+        ModeSelectorMgr().Suspend();
+    }
+
+    RestoreProgram();
+    UpdatePowerState();
+
+    if (mHasFrontPanel)
+    {
+        BootProfilerMark(BootStage::kDisplayReady);
+    }
 }
 
-void DishwasherManager::HandleOnOffClicked()
+void DishwasherManager::ScheduleFinish(DishwasherManager *&to_finish)
 {
-    if (mIsShowingReset)
+    if (mIsFinishScheduled)
     {
-        StatusDisplayMgr().HideResetOptions();
-        mIsShowingReset = false;
+        return;
+    }
+
+    mIsFinishScheduled = true;
+    mNextToFinish = to_finish;
+    to_finish = this;
+}
+
+void DishwasherManager::FinishScheduled(DishwasherManager *&to_finish)
+{
+    while (to_finish != nullptr)
+    {
+        DishwasherManager *manager = to_finish;
+
+        to_finish = manager->mNextToFinish;
+        manager->mNextToFinish = nullptr;
+        manager->mIsFinishScheduled = false;
+        manager->FinishEvents();
+    }
+}
+
+void DishwasherManager::HandleEvent(const DishwasherEvent &event)
+{
+    ESP_LOGV(TAG, "HandleEvent(%d, %lu)", (int)event.type, event.value);
+
+    switch (event.type)
+    {
+    case DishwasherEventType::kStartUp:
+        StartUp();
+        break;
+    case DishwasherEventType::kOnOffClicked:
+        HandleOnOffClicked();
+        break;
+    case DishwasherEventType::kOnOffLongPressed:
+        PresentReset();
+        break;
+    case DishwasherEventType::kStartClicked:
+        HandleStartClicked();
+        break;
+    case DishwasherEventType::kWheelClicked:
+        HandleWheelClicked();
+        break;
+    case DishwasherEventType::kEncoderNext:
+        SelectNext();
+        break;
+    case DishwasherEventType::kEncoderPrevious:
+        SelectPrevious();
+        break;
+    case DishwasherEventType::kSetPower:
+        // Our own changes to the OnOff attribute come back this way too.
+        //
+        if (event.value != 0 && !mIsPoweredOn)
+        {
+            TurnOnPower();
+        }
+        else if (event.value == 0 && mIsPoweredOn)
+        {
+            TurnOffPower();
+        }
+        break;
+    case DishwasherEventType::kStartProgram:
+        StartProgram();
+        break;
+    case DishwasherEventType::kStopProgram:
+        StopProgram();
+        break;
+    case DishwasherEventType::kPauseProgram:
+        PauseProgram();
+        break;
+    case DishwasherEventType::kResumeProgram:
+        ResumeProgram();
+        break;
+    case DishwasherEventType::kChangeMode:
+        UpdateMode((uint8_t)event.value);
+        break;
+    case DishwasherEventType::kAdjustStartTime:
+        AdjustStartTime(event.value);
+        break;
+    case DishwasherEventType::kTariffChanged:
+        ApplyTariff();
+        break;
+    case DishwasherEventType::kModifyForecast:
+        ModifyForecast();
+        break;
+    case DishwasherEventType::kPowerAdjust:
+        StartPowerCap();
+        break;
+    case DishwasherEventType::kCancelPowerAdjust:
+        EndPowerCap();
+        break;
+    case DishwasherEventType::kEnergyPause:
+        PauseForEnergy(event.value);
+        break;
+    case DishwasherEventType::kEnergyResume:
+        ResumeFromEnergyPause();
+        break;
+    case DishwasherEventType::kProgramTimer:
+        ProgressProgram();
+        break;
+    case DishwasherEventType::kDisplayRefresh:
+        RequestDisplayUpdate();
+        break;
+    case DishwasherEventType::kDisplaySleep:
+        SleepDisplay();
+        break;
+    case DishwasherEventType::kMatterPublished:
+        // Anything still unpublished goes out in FinishEvents.
+        //
+        break;
+    case DishwasherEventType::kTimeSet:
+        CatchUpProgram();
+        break;
+    case DishwasherEventType::kRunBenchmarks:
+#if CONFIG_DISHWASHER_BENCHMARK
+        RunDishwasherBenchmarks(event.value);
+#endif
+        break;
+    }
+}
+
+// Called once the queue is empty. Updates that several events asked for are
+// only made once.
+//
+void DishwasherManager::FinishEvents()
+{
+    if (mIsDisplayDirty)
+    {
+        mIsDisplayDirty = false;
+        UpdateDishwasherDisplay();
+    }
+
+    UpdateForecastProgress(NowMs());
+
+    // Both can move the program timer's next deadline.
+    //
+    bool is_reported = UpdateCountdownReport();
+    bool is_saved = UpdateCheckpoint();
+
+    if (is_reported || is_saved)
+    {
+        ArmProgramTimer();
+    }
+
+    // The snapshot goes first, as the Matter thread reads the countdown from it.
+    //
+    PublishSnapshot();
+    PublishMatterChanges();
+}
+
+void DishwasherManager::MarkMatterDirty(uint16_t attributes)
+{
+    mMatterChanges.dirty |= attributes;
+}
+
+// The countdown is only reported when CountdownReporter says so, rather than
+// every time it changes. See countdown_reporter.h.
+//
+bool DishwasherManager::UpdateCountdownReport()
+{
+    uint64_t now = NowMs();
+
+    uint32_t countdown = mEngine.GetTimeRemaining(now);
+    bool is_counting = mEngine.GetStage(now) == ProgramEngine::Stage::kRunning;
+
+    bool is_forced = mIsCountdownReportForced;
+    mIsCountdownReportForced = false;
+
+    if (!mCountdownReporter.Evaluate(now, countdown, is_counting, is_forced))
+    {
+        return false;
+    }
+
+    ESP_LOGD(TAG, "Reporting countdown of %lu seconds", countdown);
+
+    MarkMatterDirty(MatterChangeSet::kCountdownTime);
+
+    return true;
+}
+
+void DishwasherManager::MarkCheckpointDirty()
+{
+    mIsCheckpointDirty = true;
+}
+
+// A checkpoint is written when the program changes state, and every
+// CONFIG_DISHWASHER_CHECKPOINT_INTERVAL seconds while it counts down, so a
+// reboot without the time loses at most that much of the program.
+//
+bool DishwasherManager::UpdateCheckpoint()
+{
+    uint64_t now = NowMs();
+    ProgramEngine::Stage stage = mEngine.GetStage(now);
+
+    bool is_counting = stage == ProgramEngine::Stage::kDelayedStart || stage == ProgramEngine::Stage::kRunning;
+    bool is_due = is_counting && CONFIG_DISHWASHER_CHECKPOINT_INTERVAL > 0 && now - mLastCheckpointMs >= CONFIG_DISHWASHER_CHECKPOINT_INTERVAL * 1000ULL;
+
+    if (!mIsCheckpointDirty && !is_due)
+    {
+        return false;
+    }
+
+    mIsCheckpointDirty = false;
+    mLastCheckpointMs = now;
+
+    ProgramCheckpoint checkpoint = {};
+
+    checkpoint.version = kProgramCheckpointVersion;
+    // An energy manager's pause doesn't survive a restart, so the program carries on.
+    //
+    checkpoint.state = to_underlying(mIsEnergyPaused ? OperationalStateEnum::kRunning : mState);
+    checkpoint.mode = mMode;
+    checkpoint.optedIn = mOptedIntoEnergyManagement;
+
+    // Until the clock is set, a restored program is still as far from its last
+    // checkpoint's time as it has counted since, so it can be caught up from there.
+    //
+    uint32_t unix_epoch = MatterGetEpochTime();
+
+    if (unix_epoch >= kMinValidEpochTime)
+    {
+        checkpoint.savedAt = unix_epoch;
+    }
+    else if (mIsCatchUpPending)
+    {
+        checkpoint.savedAt = mCatchUpSavedAt + (uint32_t)((now - mCatchUpFromMs) / 1000);
+    }
+
+    // Kept without a program too, so forecast IDs carry on from it after a restart.
+    //
+    checkpoint.forecastId = mLastForecastId;
+
+    if (mIsProgramSelected)
+    {
+        checkpoint.startsIn = mEngine.GetStartsIn(now);
+        checkpoint.elapsed = mEngine.GetElapsed(now);
+
+        checkpoint.forecastStartTime = mForecast.startTime;
+        checkpoint.hasTimeWindow = mForecast.hasTimeWindow;
+        checkpoint.earliestStartTime = mForecast.earliestStartTime;
+        checkpoint.latestEndTime = mForecast.latestEndTime;
+        checkpoint.forecastReason = to_underlying(mForecast.reason);
+
+        for (uint8_t i = 0; i < mForecast.slotCount; i++)
+        {
+            checkpoint.stepDurations[i] = mEngine.GetStepDuration(i);
+            checkpoint.slotNominalPowers[i] = mForecast.slots[i].nominalPower;
+        }
+    }
+
+    mProgramStore.Save(checkpoint);
+
+    return is_counting;
+}
+
+// Picks up a program that was running when the device last went down, moved on
+// by the time it was off for. The clock is rarely set this early in boot, so
+// that is usually left to CatchUpProgram.
+//
+void DishwasherManager::RestoreProgram()
+{
+    ProgramCheckpoint checkpoint;
+
+    if (mProgramStore.Load(checkpoint) != ESP_OK)
+    {
+        return;
+    }
+
+    if (checkpoint.mode < kWashProgramCount)
+    {
+        mMode = checkpoint.mode;
+    }
+
+    mOptedIntoEnergyManagement = checkpoint.optedIn;
+    mLastForecastId = checkpoint.forecastId;
+    MarkMatterDirty(MatterChangeSet::kCurrentMode | MatterChangeSet::kOptOutState);
+
+    OperationalStateEnum state = (OperationalStateEnum)checkpoint.state;
+
+    if (state != OperationalStateEnum::kRunning && state != OperationalStateEnum::kPaused && checkpoint.startsIn == 0)
+    {
+        return;
+    }
+
+    uint32_t unix_epoch = MatterGetEpochTime();
+    uint32_t time_off = 0;
+
+    // A paused program doesn't move on while the device is off.
+    //
+    bool is_counting = state != OperationalStateEnum::kPaused && checkpoint.savedAt != 0;
+    bool is_clock_set = unix_epoch >= kMinValidEpochTime;
+
+    if (is_counting && is_clock_set && unix_epoch >= checkpoint.savedAt)
+    {
+        time_off = unix_epoch - checkpoint.savedAt;
+    }
+
+    uint32_t starts_in = checkpoint.startsIn;
+    uint32_t elapsed = checkpoint.elapsed;
+
+    if (starts_in > time_off)
+    {
+        starts_in -= time_off;
     }
     else
     {
-        TogglePower();
+        elapsed += time_off - starts_in;
+        starts_in = 0;
+    }
+
+    const WashProgram &program = GetWashProgram(mMode);
+
+    // The steps take as long as they did before, adjustments and all.
+    //
+    uint32_t step_durations[kMaxWashSteps];
+    uint32_t duration = 0;
+
+    for (uint8_t i = 0; i < program.stepCount; i++)
+    {
+        step_durations[i] = checkpoint.stepDurations[i] > 0 ? checkpoint.stepDurations[i] : program.steps[i].duration;
+        duration += step_durations[i];
+    }
+
+    if (elapsed >= duration)
+    {
+        ESP_LOGI(TAG, "The interrupted program finished while the dishwasher was off");
+        MarkCheckpointDirty();
+        return;
+    }
+
+    ESP_LOGI(TAG, "Resuming %s, %lu seconds in, after %lu seconds off", program.label, elapsed, time_off);
+
+    uint64_t now = NowMs();
+
+    mEngine.Start(now, starts_in, step_durations, program.stepCount, elapsed);
+    mIsProgramSelected = true;
+    mIsPoweredOn = true;
+
+    if (is_counting && !is_clock_set)
+    {
+        ESP_LOGI(TAG, "The time isn't set yet, the time off is made up once it is");
+
+        mIsCatchUpPending = true;
+        mCatchUpSavedAt = checkpoint.savedAt;
+        mCatchUpFromMs = now;
+    }
+
+    if (state == OperationalStateEnum::kPaused)
+    {
+        mEngine.Pause(now);
+    }
+
+    mPhase = to_underlying(program.steps[mEngine.GetStep(now)].phase);
+    if (starts_in > 0)
+    {
+        mState = OperationalStateEnum::kStopped;
+    }
+    else
+    {
+        mState = state == OperationalStateEnum::kPaused ? OperationalStateEnum::kPaused : OperationalStateEnum::kRunning;
+    }
+
+    mIsCountdownReportForced = true;
+
+    MarkMatterDirty(MatterChangeSet::kOnOff | MatterChangeSet::kOperationalState | MatterChangeSet::kCurrentPhase);
+
+    BuildForecast(program, checkpoint.forecastStartTime, mForecast);
+
+    for (uint8_t i = 0; i < mForecast.slotCount; i++)
+    {
+        mForecast.slots[i].defaultDuration = step_durations[i];
+
+        if (checkpoint.stepDurations[i] > 0)
+        {
+            mForecast.slots[i].nominalPower = checkpoint.slotNominalPowers[i];
+        }
+    }
+
+    // Puts the end time back in step with the durations. The forecast is
+    // published under a new ID, but it is the one the reason was given for.
+    //
+    SetForecastStartTime(mForecast, checkpoint.forecastStartTime);
+    mForecast.reason = (ForecastReason)checkpoint.forecastReason;
+
+    if (checkpoint.hasTimeWindow)
+    {
+        SetForecastTimeWindow(mForecast, checkpoint.earliestStartTime, checkpoint.latestEndTime);
+    }
+
+    SetForecast();
+    ArmProgramTimer();
+}
+
+// Called when the clock is set. Moves a program restored before then on by the
+// time the device was off, less what it has counted since it was restored.
+//
+void DishwasherManager::CatchUpProgram()
+{
+    uint32_t unix_epoch = MatterGetEpochTime();
+
+    if (!mIsCatchUpPending || unix_epoch < kMinValidEpochTime)
+    {
+        return;
+    }
+
+    mIsCatchUpPending = false;
+
+    uint64_t now = NowMs();
+    uint32_t since_restore = (uint32_t)((now - mCatchUpFromMs) / 1000);
+
+    if (unix_epoch < mCatchUpSavedAt + since_restore)
+    {
+        return;
     }
+
+    uint32_t time_off = unix_epoch - mCatchUpSavedAt - since_restore;
+
+    ESP_LOGI(TAG, "Clock set, moving the program on by the %lu seconds the dishwasher was off", time_off);
+
+    mEngine.Skip(now, time_off);
+    mIsCountdownReportForced = true;
+    MarkCheckpointDirty();
+
+    ProgressProgram();
+}
+
+uint32_t DishwasherManager::GetCheckpointWriteCount()
+{
+    return mProgramStore.GetWriteCount();
+}
+
+uint32_t DishwasherManager::GetCountdownReportCount()
+{
+    return mCountdownReporter.GetReportCount();
+}
+
+uint32_t DishwasherManager::GetCountdownSuppressedCount()
+{
+    return mCountdownReporter.GetSuppressedCount();
+}
+
+// The values are taken as they are now, so an attribute that changed several
+// times since the last publish is only written once, with its latest value.
+//
+void DishwasherManager::PublishMatterChanges()
+{
+    if (mMatterChanges.dirty == 0)
+    {
+        return;
+    }
+
+    mMatterChanges.operationalState = mState;
+    mMatterChanges.currentPhase = mPhase;
+    mMatterChanges.currentMode = mMode;
+    mMatterChanges.onOff = mIsPoweredOn;
+    mMatterChanges.optedIn = mOptedIntoEnergyManagement;
+
+    if (mMatterChanges.dirty & MatterChangeSet::kForecast)
+    {
+        mMatterChanges.forecast = mForecast;
+    }
+
+    if (mMatterChanges.dirty & MatterChangeSet::kPowerAdjustment)
+    {
+        mMatterChanges.powerAdjustment = mPowerAdjustment;
+    }
+
+    mMatterChanges.energyState = mEnergyState;
+
+    if (MatterPublishChanges(*this, mMatterChanges))
+    {
+        mMatterChanges.dirty = 0;
+    }
+}
+
+void DishwasherManager::RequestDisplayUpdate()
+{
+    mIsDisplayDirty = mHasFrontPanel;
+}
+
+void DishwasherManager::PublishSnapshot()
+{
+    mSnapshotSequence.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    mSnapshot.state = mState;
+    mSnapshot.mode = mMode;
+    mSnapshot.engine = mEngine;
+
+    mSnapshotSequence.fetch_add(1, std::memory_order_release);
+}
+
+DishwasherManager::Snapshot DishwasherManager::ReadSnapshot()
+{
+    Snapshot snapshot;
+    uint32_t sequence;
+
+    do
+    {
+        sequence = mSnapshotSequence.load(std::memory_order_acquire);
+        snapshot = mSnapshot;
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((sequence & 1) != 0 || sequence != mSnapshotSequence.load(std::memory_order_relaxed));
+
+    return snapshot;
+}
+
+void DishwasherManager::ArmProgramTimer()
+{
+    esp_timer_stop(mProgramTimer);
+
+    uint64_t now = NowMs();
+    uint64_t deadline = mEngine.GetNextDeadline(now);
+
+    // The timer also wakes us for the next periodic countdown report and checkpoint.
+    //
+    uint64_t report_deadline = mCountdownReporter.GetNextDeadline();
+
+    if (report_deadline < deadline)
+    {
+        deadline = report_deadline;
+    }
+
+    ProgramEngine::Stage stage = mEngine.GetStage(now);
+
+    if (CONFIG_DISHWASHER_CHECKPOINT_INTERVAL > 0 && (stage == ProgramEngine::Stage::kDelayedStart || stage == ProgramEngine::Stage::kRunning))
+    {
+        uint64_t checkpoint_deadline = mLastCheckpointMs + CONFIG_DISHWASHER_CHECKPOINT_INTERVAL * 1000ULL;
+
+        if (checkpoint_deadline < deadline)
+        {
+            deadline = checkpoint_deadline;
+        }
+    }
+
+    if (mIsPowerCapped && mPowerCapEndMs < deadline)
+    {
+        deadline = mPowerCapEndMs;
+    }
+
+    if (mIsEnergyPaused && mEnergyPauseEndMs < deadline)
+    {
+        deadline = mEnergyPauseEndMs;
+    }
+
+    if (deadline != ProgramEngine::kNoDeadline)
+    {
+        uint64_t delay_ms = deadline > now ? deadline - now : 0;
+        esp_timer_start_once(mProgramTimer, delay_ms * 1000);
+    }
+
+    UpdatePowerState();
+}
+
+void DishwasherManager::UpdatePowerState()
+{
+    bool is_running = mEngine.GetStage(NowMs()) == ProgramEngine::Stage::kRunning;
+
+    // A running program keeps the display on, so it can be seen to start.
+    //
+    if (mIsPoweredOn && is_running)
+    {
+        SetDisplayAwake(true);
+    }
+
+    bool can_sleep = CONFIG_DISHWASHER_DISPLAY_SLEEP_TIMEOUT > 0 && mIsDisplayAwake && !is_running && !mIsShowingReset;
+
+    if (!can_sleep)
+    {
+        esp_timer_stop(mDisplaySleepTimer);
+    }
+    else if (!esp_timer_is_active(mDisplaySleepTimer))
+    {
+        esp_timer_start_once(mDisplaySleepTimer, CONFIG_DISHWASHER_DISPLAY_SLEEP_TIMEOUT * 1000000ULL);
+    }
+
+    UpdateDisplayRefresh();
+
+    if (mHasFrontPanel)
+    {
+        PowerMgr().Update(mIsDisplayAwake, is_running);
+    }
+}
+
+void DishwasherManager::UpdateDisplayRefresh()
+{
+    // The countdown only moves while the program is waiting to start or running.
+    //
+    ProgramEngine::Stage stage = mEngine.GetStage(NowMs());
+
+    bool needs_refresh = mIsDisplayAwake && (stage == ProgramEngine::Stage::kDelayedStart || stage == ProgramEngine::Stage::kRunning);
+
+    if (needs_refresh == mIsDisplayRefreshRunning)
+    {
+        return;
+    }
+
+    if (needs_refresh)
+    {
+        esp_timer_start_periodic(mDisplayRefreshTimer, 1000 * 1000);
+    }
+    else
+    {
+        esp_timer_stop(mDisplayRefreshTimer);
+    }
+
+    mIsDisplayRefreshRunning = needs_refresh;
+}
+
+void DishwasherManager::SetDisplayAwake(bool is_awake)
+{
+    // Without a display there is nothing to wake, so a headless dishwasher
+    // never needs the refresh or sleep timers.
+    //
+    if (!mHasFrontPanel || is_awake == mIsDisplayAwake)
+    {
+        return;
+    }
+
+    mIsDisplayAwake = is_awake;
+
+    if (is_awake)
+    {
+        StatusDisplayMgr().TurnOn();
+        ModeSelectorMgr().Resume();
+        RequestDisplayUpdate();
+    }
+    else
+    {
+        ModeSelectorMgr().Suspend();
+        StatusDisplayMgr().TurnOff();
+    }
+}
+
+void DishwasherManager::SleepDisplay()
+{
+    ESP_LOGI(TAG, "No input for %d seconds, putting the display to sleep", CONFIG_DISHWASHER_DISPLAY_SLEEP_TIMEOUT);
+
+    SetDisplayAwake(false);
+    UpdatePowerState();
+}
+
+// Input restarts the display's sleep timeout. Returns true if the display was
+// asleep, in which case the input only wakes it, as whoever gave it couldn't
+// see what it would do.
+//
+bool DishwasherManager::HandleActivity()
+{
+    if (!mIsPoweredOn || !mHasFrontPanel)
+    {
+        return false;
+    }
+
+    bool was_asleep = !mIsDisplayAwake;
+
+    SetDisplayAwake(true);
+    esp_timer_stop(mDisplaySleepTimer);
+    UpdatePowerState();
+
+    return was_asleep;
+}
+
+void DishwasherManager::PresentReset()
+{
+    HandleActivity();
+
+    if (!mHasFrontPanel)
+    {
+        return;
+    }
+
+    mIsShowingReset = true;
+    StatusDisplayMgr().ShowResetOptions();
+    UpdatePowerState();
+}
+
+void DishwasherManager::HandleOnOffClicked()
+{
+    if (mIsShowingReset)
+    {
+        StatusDisplayMgr().HideResetOptions();
+        mIsShowingReset = false;
+        UpdatePowerState();
+    }
+    else if (!HandleActivity())
+    {
+        TogglePower();
+    }
+}
+
+void DishwasherManager::HandleStartClicked()
+{
+    if (!mIsPoweredOn)
+    {
+        ESP_LOGI(TAG, "Dishwasher is off, cannot handle start");
+        return;
+    }
+
+    if (HandleActivity())
+    {
+        return;
+    }
+
+    if (mIsShowingReset)
+    {
+        MatterFactoryReset();
+        mIsShowingReset = false;
+    }
+    else
+    {
+        ToggleProgram();
+    }
+}
+
+uint32_t DishwasherManager::GetTimeRemaining()
+{
+    return ReadSnapshot().engine.GetTimeRemaining(NowMs());
+}
+
+void DishwasherManager::TogglePower()
+{
+    if (mIsPoweredOn)
+    {
+        TurnOffPower();
+    }
+    else
+    {
+        TurnOnPower();
+    }
+
+    MarkMatterDirty(MatterChangeSet::kOnOff);
+}
+
+void DishwasherManager::TurnOnPower()
+{
+    mIsPoweredOn = true;
+    SetDisplayAwake(true);
+    UpdatePowerState();
+}
+
+void DishwasherManager::TurnOffPower()
+{
+    mIsPoweredOn = false;
+    StopProgram();
+    SetDisplayAwake(false);
+    UpdatePowerState();
+}
+
+bool DishwasherManager::IsPoweredOn()
+{
+    return mIsPoweredOn;
+}
+
+void DishwasherManager::ToggleProgram()
+{
+    if (mState == OperationalStateEnum::kStopped)
+    {
+        StartProgram();
+    }
+    else if (mState == OperationalStateEnum::kRunning)
+    {
+        PauseProgram();
+    }
+    else if (mState == OperationalStateEnum::kPaused)
+    {
+        ResumeProgram();
+    }
+}
+
+void DishwasherManager::StartProgram()
+{
+    mIsProgramSelected = true;
+    mIsCatchUpPending = false;
+    mCappedStep = {};
+
+    const WashProgram &program = GetWashProgram(mMode);
+
+    mPhase = to_underlying(program.steps[0].phase);
+
+    uint32_t step_durations[kMaxWashSteps];
+
+    for (uint8_t i = 0; i < program.stepCount; i++)
+    {
+        step_durations[i] = program.steps[i].duration;
+    }
+
+    // Configure the forecast for the selected program.
+    //
+    uint32_t unixEpoch = MatterGetEpochTime();
+
+    ESP_LOGI(TAG, "Matter time: %lu", unixEpoch);
+
+    uint32_t delayed_start = 0; // Start immediately.
+
+    if (mOptedIntoEnergyManagement)
+    {
+        delayed_start = kMinStartDelay; // Start in one minute to allow for optimisation
+    }
+
+    BuildForecast(program, unixEpoch + delayed_start, mForecast);
+
+    if (mOptedIntoEnergyManagement)
+    {
+        SetForecastTimeWindow(mForecast, unixEpoch, unixEpoch + CONFIG_DISHWASHER_SCHEDULE_WINDOW * 3600);
+
+        // Move the start to the cheapest time in the window we know of. Without
+        // the time, there is no telling where we are on the tariff.
+        //
+        uint32_t start_time;
+
+        if (unixEpoch >= kMinValidEpochTime && FindCheapestStart(mForecast, mTariff, unixEpoch + kMinStartDelay, mForecast.latestEndTime, start_time) &&
+            start_time != mForecast.startTime)
+        {
+            ESP_LOGI(TAG, "Cheapest start is in %lu seconds", start_time - unixEpoch);
+
+            delayed_start = start_time - unixEpoch;
+            SetForecastStartTime(mForecast, start_time);
+            mForecast.reason = ForecastReason::kLocalOptimization;
+        }
+    }
+
+    mEngine.Start(NowMs(), delayed_start, step_durations, program.stepCount);
+    MarkCheckpointDirty();
+
+    if (delayed_start == 0)
+    {
+        UpdateOperationState(OperationalStateEnum::kRunning);
+        UpdateCurrentPhase(mPhase);
+    }
+
+    ArmProgramTimer();
+
+    SetForecast();
+}
+
+// Called from any task, such as the Matter thread with the constraints from a
+// RequestConstraintBasedForecast. Returns false if the last tariff posted
+// hasn't been picked up yet.
+//
+bool DishwasherManager::PostTariff(const TariffCurve &tariff)
+{
+    return mTariffMailbox.Post(*this, DishwasherEventType::kTariffChanged, tariff);
+}
+
+// Takes the tariff posted with PostTariff and, if a program is waiting to
+// start, moves it to the cheapest start time in its window.
+//
+void DishwasherManager::ApplyTariff()
+{
+    if (!mTariffMailbox.Take(mTariff))
+    {
+        return;
+    }
+
+    ESP_LOGI(TAG, "New tariff with %u buckets of %lu seconds", mTariff.bucketCount, mTariff.bucketDuration);
+
+    if (!mOptedIntoEnergyManagement || mEngine.GetStage(NowMs()) != ProgramEngine::Stage::kDelayedStart || !mForecast.hasTimeWindow)
+    {
+        return;
+    }
+
+    uint32_t unixEpoch = MatterGetEpochTime();
+    uint32_t start_time;
+
+    if (unixEpoch < kMinValidEpochTime)
+    {
+        return;
+    }
+
+    uint32_t earliest_start = mForecast.earliestStartTime > unixEpoch ? mForecast.earliestStartTime : unixEpoch;
+
+    if (FindCheapestStart(mForecast, mTariff, earliest_start, mForecast.latestEndTime, start_time) && start_time != mForecast.startTime)
+    {
+        AdjustStartTime(start_time);
+    }
+}
+
+// Only a program still waiting for its delayed start can be moved, and only
+// once the clock is set, as the new delay is worked out from it.
+//
+void DishwasherManager::AdjustStartTime(uint32_t new_start_time)
+{
+    if (!mOptedIntoEnergyManagement)
+    {
+        return;
+    }
+
+    uint64_t now = NowMs();
+    uint32_t unixEpoch = MatterGetEpochTime();
+
+    if (mEngine.GetStage(now) != ProgramEngine::Stage::kDelayedStart || unixEpoch < kMinValidEpochTime)
+    {
+        ESP_LOGW(TAG, "Ignoring a start time adjustment, no program is waiting to start or the time isn't set");
+        return;
+    }
+
+    SetForecastStartTime(mForecast, new_start_time);
+    mForecast.reason = ForecastReason::kGridOptimization;
+
+    // Update the delay.
+    //
+    uint32_t delayed_start = new_start_time > unixEpoch ? new_start_time - unixEpoch : 0;
+
+    mEngine.SetStartDelay(now, delayed_start);
+    MarkCheckpointDirty();
+    ArmProgramTimer();
+
+    RequestDisplayUpdate();
+
+    SetForecast();
+}
+
+// Called from any task, like PostTariff.
+//
+bool DishwasherManager::PostForecastAdjustment(const ForecastAdjustment &adjustment)
+{
+    return mAdjustmentMailbox.Post(*this, DishwasherEventType::kModifyForecast, adjustment);
+}
+
+// Applies a ModifyForecastRequest to the program's steps, one slot per step,
+// and publishes the forecast again under a new ID. The cluster server has
+// already checked the request against the forecast that was published, but
+// the program may have moved on since.
+//
+void DishwasherManager::ModifyForecast()
+{
+    ForecastAdjustment published;
+
+    if (!mAdjustmentMailbox.Take(published))
+    {
+        return;
+    }
+
+    ForecastAdjustment adjustment;
+
+    if (!mIsProgramSelected || published.forecastId != mForecast.forecastId || !CollapseForecastAdjustment(mForecast, published, adjustment) ||
+        !IsValidForecastAdjustment(mForecast, adjustment))
+    {
+        ESP_LOGW(TAG, "Ignoring an adjustment to forecast %lu", published.forecastId);
+        return;
+    }
+
+    // The capped step's duration is ours to set until the cap ends.
+    //
+    if (mIsPowerCapped)
+    {
+        ESP_LOGW(TAG, "Ignoring an adjustment while the power is capped");
+        return;
+    }
+
+    ForecastPlan forecast = mForecast;
+    ApplyForecastAdjustment(forecast, adjustment);
+
+    uint32_t step_durations[kMaxForecastSlots];
+
+    for (uint8_t i = 0; i < forecast.slotCount; i++)
+    {
+        step_durations[i] = forecast.slots[i].defaultDuration;
+    }
+
+    if (!mEngine.SetStepDurations(NowMs(), step_durations, forecast.slotCount))
+    {
+        ESP_LOGW(TAG, "Ignoring an adjustment to a step that has already finished");
+        return;
+    }
+
+    mForecast = forecast;
+
+    // The adjusted slots are the steps' figures from now on.
+    //
+    mCappedStep.hasBaseline = false;
+
+    ESP_LOGI(TAG, "Forecast %lu adjusted, program now takes %lu seconds", mForecast.forecastId, GetForecastDuration(mForecast));
+
+    ArmProgramTimer();
+    RequestDisplayUpdate();
+    SetForecast();
+}
+
+// Called from the Matter thread.
+//
+bool DishwasherManager::PostPowerCap(const PowerCap &cap)
+{
+    return mPowerCapMailbox.Post(*this, DishwasherEventType::kPowerAdjust, cap);
+}
+
+bool DishwasherManager::PostCancelPowerCap()
+{
+    return DishwasherPostEvent(*this, DishwasherEventType::kCancelPowerAdjust);
+}
+
+// Caps the heater for the duration of a PowerAdjustRequest. The step being run
+// gets the same energy at the lower power, so it takes longer, and so does the
+// program. A new request replaces the one in force.
+//
+void DishwasherManager::StartPowerCap()
+{
+    PowerCap cap;
+
+    if (!mPowerCapMailbox.Take(cap))
+    {
+        return;
+    }
+
+    uint64_t now = NowMs();
+
+    if (!mIsProgramSelected || mEngine.GetStage(now) != ProgramEngine::Stage::kRunning)
+    {
+        ESP_LOGW(TAG, "Ignoring a power adjustment, no program is running");
+        return;
+    }
+
+    ReleaseCappedStep(now);
+
+    mIsPowerCapped = true;
+    mPowerCap = cap;
+    mPowerCapEndMs = now + cap.duration * 1000ULL;
+
+    ESP_LOGI(TAG, "Power capped at %lld mW for %lu seconds", cap.power, cap.duration);
+
+    CapCurrentStep(now);
+
+    mIsCountdownReportForced = true;
+    UpdatePowerAdjustment();
+    ArmProgramTimer();
+    RequestDisplayUpdate();
+}
+
+// Ends the cap when it expires, is cancelled, or the program stops running.
+// Whatever is left of the step goes back to its nominal power.
+//
+void DishwasherManager::EndPowerCap()
+{
+    if (!mIsPowerCapped)
+    {
+        return;
+    }
+
+    ReleaseCappedStep(NowMs());
+
+    mIsPowerCapped = false;
+
+    ESP_LOGI(TAG, "Power cap ended, program now takes %lu seconds", mEngine.GetTotalDuration());
+
+    mIsCountdownReportForced = true;
+    UpdatePowerAdjustment();
+    ArmProgramTimer();
+    RequestDisplayUpdate();
 }
 
-void DishwasherManager::HandleStartClicked()
+// Stretches what is left of the current step so it delivers the same energy at
+// the capped power. Only the part of the step inside the cap is slowed down.
+//
+void DishwasherManager::CapCurrentStep(uint64_t now)
 {
-    if (!mIsPoweredOn)
+    uint8_t step = mEngine.GetStep(now);
+
+    mIsStepCapped = false;
+
+    if (step >= mForecast.slotCount)
     {
-        ESP_LOGI(TAG, "Dishwasher is off, cannot handle start");
+        mCappedStep.step = step;
+        mCappedStep.hasBaseline = false;
         return;
     }
 
-    if (mIsShowingReset)
+    const ForecastPlanSlot &slot = mForecast.slots[step];
+
+    if (!mCappedStep.hasBaseline || mCappedStep.step != step)
     {
-        esp_matter::factory_reset();
-        mIsShowingReset = false;
+        mCappedStep.step = step;
+        mCappedStep.hasBaseline = true;
+        mCappedStep.nominalPower = slot.nominalPower;
+        mCappedStep.energy = slot.nominalPower * slot.defaultDuration;
     }
-    else
+
+    int64_t nominal_power = mCappedStep.nominalPower;
+
+    // The heater can't go below the step's minimum, and a cap above what the
+    // step draws anyway changes nothing.
+    //
+    int64_t power = mPowerCap.power > slot.minPower ? mPowerCap.power : slot.minPower;
+
+    if (power >= nominal_power)
     {
-        ToggleProgram();
+        return;
     }
-}
 
-uint32_t DishwasherManager::GetTimeRemaining()
-{
-    return mRunningTimeRemaining;
+    uint64_t work_ms = mEngine.GetStepRemainingMs(now);
+    uint64_t window_ms = mPowerCapEndMs > now ? mPowerCapEndMs - now : 0;
+    uint64_t stretched_ms = work_ms * nominal_power / power;
+
+    // If the cap ends first, the rest of the work is done at nominal power.
+    //
+    if (stretched_ms > window_ms)
+    {
+        stretched_ms = window_ms + (work_ms - window_ms * power / nominal_power);
+    }
+
+    mCappedStep.startMs = now;
+    mCappedStep.workMs = work_ms;
+    mCappedStep.power = power;
+    mIsStepCapped = true;
+
+    mEngine.SetStepRemaining(now, stretched_ms);
+
+    UpdateCappedSlot();
 }
 
-void DishwasherManager::TogglePower()
+// Gives the step back whatever work was not done under the cap.
+//
+void DishwasherManager::ReleaseCappedStep(uint64_t now)
 {
-    if (mIsPoweredOn)
+    if (!mIsStepCapped)
     {
-        TurnOffPower();
+        return;
     }
-    else
+
+    mIsStepCapped = false;
+
+    if (mEngine.GetStage(now) != ProgramEngine::Stage::kRunning || mEngine.GetStep(now) != mCappedStep.step)
     {
-        TurnOnPower();
+        return;
     }
 
-    // We can update the OnOff attribute directly as its managed by esp-matter.
-    //
-    uint16_t endpoint_id = 0x01;
-    uint32_t cluster_id = OnOff::Id;
-    uint32_t attribute_id = OnOff::Attributes::OnOff::Id;
+    uint64_t done_ms = (now - mCappedStep.startMs) * mCappedStep.power / mCappedStep.nominalPower;
+    uint64_t remaining_ms = mCappedStep.workMs > done_ms ? mCappedStep.workMs - done_ms : 0;
 
-    esp_matter::attribute_t *attribute = esp_matter::attribute::get(endpoint_id, cluster_id, attribute_id);
+    mEngine.SetStepRemaining(now, remaining_ms);
 
-    esp_matter_attr_val_t val = esp_matter_invalid(NULL);
-    esp_matter::attribute::get_val(attribute, &val);
-    val.val.b = mIsPoweredOn;
-    esp_matter::attribute::update(endpoint_id, cluster_id, attribute_id, &val);
+    UpdateCappedSlot();
 }
 
-void DishwasherManager::TurnOnPower()
+// The forecast follows the step as it is stretched: the slot takes as long as
+// the engine says and its average power falls to keep the energy the same.
+// Only the published slot is averaged; the step's own figures stay in
+// mCappedStep.
+//
+void DishwasherManager::UpdateCappedSlot()
 {
-    mIsPoweredOn = true;
-    StatusDisplayMgr().TurnOn();
-    UpdateDishwasherDisplay();
-}
+    ForecastPlanSlot &slot = mForecast.slots[mCappedStep.step];
+    uint32_t duration = mEngine.GetStepDuration(mCappedStep.step);
 
-void DishwasherManager::TurnOffPower()
-{
-    mIsPoweredOn = false;
-    StopProgram();
-    StatusDisplayMgr().TurnOff();
-}
+    if (duration == 0)
+    {
+        return;
+    }
 
-bool DishwasherManager::IsPoweredOn()
-{
-    return mIsPoweredOn;
+    slot.defaultDuration = duration;
+    slot.nominalPower = mCappedStep.energy / duration;
+
+    SetForecastStartTime(mForecast, mForecast.startTime);
+    mForecast.reason = mPowerCap.cause;
+
+    SetForecast();
 }
 
-void DishwasherManager::ToggleProgram()
+// The PowerAdjustmentCapability follows the step being run, so it changes with
+// the phase and the operational state.
+//
+void DishwasherManager::UpdatePowerAdjustment()
 {
-    if (mState == OperationalStateEnum::kStopped)
-    {
-        StartProgram();
-    }
-    else if (mState == OperationalStateEnum::kRunning)
-    {
-        PauseProgram();
-    }
-    else if (mState == OperationalStateEnum::kPaused)
+    uint64_t now = NowMs();
+
+    PowerAdjustPlan plan;
+
+    if (mIsProgramSelected && mEngine.GetStage(now) == ProgramEngine::Stage::kRunning)
     {
-        ResumeProgram();
+        const WashStep &step = GetWashProgram(mMode).steps[mEngine.GetStep(now)];
+
+        plan.isAvailable = true;
+        plan.minPower = step.minPower;
+        plan.maxPower = step.maxPower;
+        plan.minDuration = kMinPowerAdjustDuration;
+        plan.maxDuration = mEngine.GetTimeRemaining(now);
+
+        if (plan.maxDuration < plan.minDuration)
+        {
+            plan.maxDuration = plan.minDuration;
+        }
     }
+
+    plan.isActive = mIsPowerCapped;
+    plan.cause = mPowerCap.cause;
+
+    mPowerAdjustment = plan;
+    MarkMatterDirty(MatterChangeSet::kPowerAdjustment);
+
+    UpdateEnergyState();
 }
 
-// Track this separately as we need to set some values in the forecast struct.
+// Sheds the load for a PauseRequest. The cluster server has already checked
+// the active slot is pausable and the duration is within its limits, so all
+// that's left is to make sure the program is still running.
 //
-chip::app::Clusters::DeviceEnergyManagement::Structs::SlotStruct::Type sSlots[10];
-chip::app::Clusters::DeviceEnergyManagement::Structs::ForecastStruct::Type sForecastStruct;
-
-void DishwasherManager::StartProgram()
+void DishwasherManager::PauseForEnergy(uint32_t duration)
 {
-    mIsProgramSelected = true;
+    uint64_t now = NowMs();
 
-    // 30 minutes in seconds = 1800
-    // 60 minutes in seconds = 3600
-    // 90 minutes in seconds = 5400
-    mRunningTimeRemaining = 1800 + (mMode * 1800);
-    mPhase = 0;
+    if (!mIsProgramSelected || mEngine.GetStage(now) != ProgramEngine::Stage::kRunning)
+    {
+        ESP_LOGW(TAG, "Ignoring a pause request, no program is running");
+        return;
+    }
 
-    // UpdateCurrentPhase(mPhase);
-    // UpdateOperationState(OperationalStateEnum::kRunning);
+    ESP_LOGI(TAG, "Pausing for %lu seconds at the energy manager's request", duration);
 
-    // Configure the forecast for the selected program.
-    //
+    mIsEnergyPaused = true;
+    mEnergyPauseEndMs = now + duration * 1000ULL;
 
-    // Get the current time.
-    //
-    // struct timeval tv_now;
-    // gettimeofday(&tv_now, NULL);
-    // uint32_t matterEpoch = tv_now.tv_sec;
-    // ESP_LOGI(TAG, "Current time: %lu", matterEpoch);
+    PauseProgram();
+}
 
-    // Get the current time the CHIP way...
-    //
-    System::Clock::Microseconds64 utcTime;
-    chip::System::SystemClock().GetClock_RealTime(utcTime);
+// Called for a ResumeRequest, or by ProgressProgram once the pause is over.
+//
+void DishwasherManager::ResumeFromEnergyPause()
+{
+    if (!mIsEnergyPaused)
+    {
+        return;
+    }
 
-    time_t unixEpoch = std::chrono::duration_cast<chip::System::Clock::Seconds32>(utcTime).count();
+    ESP_LOGI(TAG, "Resuming after the energy manager's pause");
 
-    ESP_LOGI(TAG, "Matter time: %llu", unixEpoch);
+    ResumeProgram();
+}
 
-    // char buf[50];
-    // tm calendarTime{};
-    // localtime_r(&unixEpoch, &calendarTime);
-    // ESP_LOGI(TAG, "The date and time is %s", asctime_r(&calendarTime, buf));
+void DishwasherManager::UpdateEnergyState()
+{
+    EnergyState state = EnergyState::kOnline;
 
-    if (mOptedIntoEnergyManagement)
+    if (mIsEnergyPaused)
     {
-        mDelayedStartTimeRemaining = 60; // Start in one minute to allow for optimisation
+        state = EnergyState::kPaused;
     }
-    else
+    else if (mIsPowerCapped)
     {
-        mDelayedStartTimeRemaining = 0; // Start immediately.
+        state = EnergyState::kPowerAdjustActive;
     }
 
-    sForecastStruct.forecastID = 0; // TODO This should change each time the forecast changes.
-    sForecastStruct.startTime = unixEpoch + mDelayedStartTimeRemaining;
-    sForecastStruct.endTime = unixEpoch + mDelayedStartTimeRemaining + mRunningTimeRemaining;
-
-    if (mOptedIntoEnergyManagement)
+    if (state != mEnergyState)
     {
-        sForecastStruct.earliestStartTime = MakeOptional(unixEpoch);
-        sForecastStruct.latestEndTime = MakeOptional(unixEpoch + 86400 /* 24 hours */);
+        mEnergyState = state;
+        MarkMatterDirty(MatterChangeSet::kEnergyState);
     }
-    else
+}
+
+// Brings the forecast's active slot and slot times up to date. They are only
+// republished at a slot boundary, or once the program's end has drifted from
+// the published one by more than CONFIG_DISHWASHER_FORECAST_DRIFT_THRESHOLD
+// seconds, as it does through a pause. Called after every batch of events.
+//
+void DishwasherManager::UpdateForecastProgress(uint64_t now)
+{
+    ProgramEngine::Stage stage = mEngine.GetStage(now);
+
+    if (mForecast.slotCount == 0 || (stage != ProgramEngine::Stage::kRunning && stage != ProgramEngine::Stage::kPaused))
     {
-        sForecastStruct.earliestStartTime.ClearValue();
-        sForecastStruct.latestEndTime.ClearValue();
+        return;
     }
-    
-    sForecastStruct.isPausable = false;         // We cannot pause any of the slots in this forecast.
-    sForecastStruct.activeSlotNumber.SetNull(); // TODO Change this accordingly as the program progresses.
 
-    int32_t slot_count = 1;
+    uint8_t active_slot = mEngine.GetStep(now);
+    uint32_t remaining = mEngine.GetTimeRemaining(now);
+    uint64_t end_ms = now + remaining * 1000ULL;
+    uint64_t drift_ms = end_ms > mForecastEndMs ? end_ms - mForecastEndMs : mForecastEndMs - end_ms;
 
-    sSlots[0].minDuration = 1800;
-    sSlots[0].maxDuration = 1800;
-    sSlots[0].defaultDuration = 1800;
+    // A step can be published as several slots, each with its own boundary.
+    //
+    uint32_t step_remaining = (uint32_t)((mEngine.GetStepRemainingMs(now) + 999) / 1000);
+    uint32_t step_duration = mEngine.GetStepDuration(active_slot);
+    uint32_t step_elapsed = step_duration > step_remaining ? step_duration - step_remaining : 0;
 
-    // slots[0].elapsedSlotTime = 0;
-    // slots[0].remainingSlotTime = 0;
+    bool is_boundary = !mForecast.hasActiveSlot || GetPublishedSlotIndex(mForecast, active_slot, step_elapsed) != mPublishedActiveSlot;
 
-    // slots[0].slotIsPausable.SetValue(true);
-    // slots[0].minPauseDuration.SetValue(10);
-    // slots[0].maxPauseDuration.SetValue(60);
+    if (!is_boundary && drift_ms <= CONFIG_DISHWASHER_FORECAST_DRIFT_THRESHOLD * 1000ULL)
+    {
+        return;
+    }
 
-    sSlots[0].nominalPower.SetValue(3000000);
-    sSlots[0].minPower.SetValue(3000000);
-    sSlots[0].maxPower.SetValue(3000000);
+    mForecast.hasActiveSlot = true;
+    mForecast.activeSlotNumber = active_slot;
 
-    if (mMode >= 1)
+    for (uint8_t i = 0; i < mForecast.slotCount && i < kMaxForecastSlots; i++)
     {
-        sSlots[1].minDuration = 30 * 60;
-        sSlots[1].maxDuration = 30 * 60;
-        sSlots[1].defaultDuration = 30 * 60;
-        sSlots[1].nominalPower.SetValue(3000000);
-        sSlots[1].minPower.SetValue(3000000);
-        sSlots[1].maxPower.SetValue(3000000);
+        ForecastPlanSlot &slot = mForecast.slots[i];
+        uint32_t duration = mEngine.GetStepDuration(i);
 
-        slot_count = 2;
+        if (i < active_slot)
+        {
+            slot.elapsedTime = duration;
+            slot.remainingTime = 0;
+        }
+        else if (i == active_slot)
+        {
+            slot.elapsedTime = step_elapsed;
+            slot.remainingTime = step_remaining;
+        }
+        else
+        {
+            slot.elapsedTime = 0;
+            slot.remainingTime = duration;
+        }
     }
 
-    if (mMode >= 2)
-    {
-        sSlots[2].minDuration = 30 * 60;
-        sSlots[2].maxDuration = 30 * 60;
-        sSlots[2].defaultDuration = 30 * 60;
-        sSlots[2].nominalPower.SetValue(3000000);
-        sSlots[2].minPower.SetValue(3000000);
-        sSlots[2].maxPower.SetValue(3000000);
+    uint32_t unix_epoch = MatterGetEpochTime();
 
-        slot_count = 3;
+    if (unix_epoch >= kMinValidEpochTime)
+    {
+        mForecast.endTime = unix_epoch + remaining;
     }
 
-    sForecastStruct.slots = DataModel::List<DeviceEnergyManagement::Structs::SlotStruct::Type>(sSlots, slot_count);
+    mForecastEndMs = end_ms;
 
     SetForecast();
 }
 
-void DishwasherManager::AdjustStartTime(uint32_t new_start_time)
+// Only a running program can be paused. One still waiting for its delayed
+// start, or already paused, is left as it is.
+//
+void DishwasherManager::PauseProgram()
 {
-    if (mOptedIntoEnergyManagement)
+    if (mEngine.GetStage(NowMs()) != ProgramEngine::Stage::kRunning)
     {
-        // TODO If the program has started, we can't adjust the start time.
-        //
-        sForecastStruct.startTime = new_start_time;
-        sForecastStruct.endTime = new_start_time + ((30 + (mMode * 30)) * 60);
-        sForecastStruct.forecastUpdateReason = DeviceEnergyManagement::ForecastUpdateReasonEnum::kGridOptimization;
-
-        // Update the delay.
-        //
-        System::Clock::Microseconds64 utcTime;
-        chip::System::SystemClock().GetClock_RealTime(utcTime);
-
-        time_t unixEpoch = std::chrono::duration_cast<chip::System::Clock::Seconds32>(utcTime).count();
-
-        mDelayedStartTimeRemaining = new_start_time - unixEpoch;
-
-        UpdateDishwasherDisplay();
-
-        SetForecast();
+        ESP_LOGW(TAG, "Ignoring a pause, no program is running");
+        return;
     }
-}
 
-void DishwasherManager::PauseProgram()
-{
+    EndPowerCap();
+    mEngine.Pause(NowMs());
+    ArmProgramTimer();
     UpdateOperationState(OperationalStateEnum::kPaused);
 }
 
 void DishwasherManager::ResumeProgram()
 {
+    // However it is resumed, an energy manager's pause is over.
+    //
+    mIsEnergyPaused = false;
+
+    mEngine.Resume(NowMs());
+    ArmProgramTimer();
     UpdateOperationState(OperationalStateEnum::kRunning);
 }
 
 void DishwasherManager::StopProgram()
 {
     mIsProgramSelected = false;
-    mDelayedStartTimeRemaining = 0;
-    mRunningTimeRemaining = 0;
+    mIsCatchUpPending = false;
+    mIsPowerCapped = false;
+    mIsStepCapped = false;
+    mIsEnergyPaused = false;
+    mEngine.Stop();
+    ArmProgramTimer();
     UpdateCurrentPhase(0);
     UpdateMode(0);
     UpdateOperationState(OperationalStateEnum::kStopped);
@@ -313,90 +1525,71 @@ void DishwasherManager::EndProgram()
 
 OperationalStateEnum DishwasherManager::GetOperationalState()
 {
-    return mState;
+    return ReadSnapshot().state;
+}
+
+bool DishwasherManager::IsProgramRunning()
+{
+    return ReadSnapshot().engine.GetStage(NowMs()) == ProgramEngine::Stage::kRunning;
+}
+
+bool DishwasherManager::IsProgramSelected()
+{
+    return ReadSnapshot().engine.GetStage(NowMs()) != ProgramEngine::Stage::kIdle;
+}
+
+bool DishwasherManager::IsWaitingToStart()
+{
+    return ReadSnapshot().engine.GetStage(NowMs()) == ProgramEngine::Stage::kDelayedStart;
 }
 
 uint8_t DishwasherManager::GetCurrentMode()
 {
-    return mMode;
+    return ReadSnapshot().mode;
 }
 
 void DishwasherManager::UpdateDishwasherDisplay()
 {
-    ESP_LOGI(TAG, "UpdateDishwasherDisplay called!");
+    ESP_LOGV(TAG, "UpdateDishwasherDisplay called!");
+
+    uint64_t now = NowMs();
 
-    char *state_text = "";
-    char *mode_text = "";
-    char *status_text = "";
+    StatusViewModel view = {};
+
+    view.isShowingMenu = mIsShowingMenu;
+    view.hasOptedIn = mOptedIntoEnergyManagement;
+    view.isProgramSelected = mIsProgramSelected;
+    view.startsIn = mEngine.GetStartsIn(now);
+    view.mode = mMode;
+    view.timeRemaining = mEngine.GetTimeRemaining(now);
+
+    ESP_LOGV(TAG, "Time Remaining: %lu", view.timeRemaining);
 
     switch (mState)
     {
     case OperationalStateEnum::kRunning:
-        state_text = "RUNNING";
+        view.state = RUNNING;
         break;
     case OperationalStateEnum::kPaused:
-        state_text = "PAUSED";
+        view.state = PAUSED;
         break;
     case OperationalStateEnum::kStopped:
-        state_text = "STOPPED";
+        view.state = STOPPED;
         break;
-    case OperationalStateEnum::kError:
+    default:
         // sDishwasherLED.Blink(100);
         //  TODO Blink the three LEDS?!
+        view.state = ERROR;
         break;
-    default:
-        break;
-    }
-
-    ESP_LOGI(TAG, "Time Remaining: %lu", mRunningTimeRemaining);
-
-    char time_buffer[30] = "";
-
-    if (mRunningTimeRemaining > 0)
-    {
-        sprintf(time_buffer, "%lus", mRunningTimeRemaining);
-    }
-
-    char mode_buffer[64];
-
-    DishwasherModeDelegate *delegate = (DishwasherModeDelegate *)DishwasherMode::GetDelegate();
-
-    if (delegate != nullptr)
-    {
-        MutableCharSpan label(mode_buffer);
-
-        delegate->GetModeLabelByIndex(mMode, label);
-
-        mode_text = mode_buffer;
     }
 
-    char status_buffer[64];
-    char *status_formatted_buffer = NULL;
-
     if (mState == OperationalStateEnum::kRunning || mState == OperationalStateEnum::kPaused)
     {
-        OperationalStateDelegate *operational_state_delegate = (OperationalStateDelegate *)OperationalState::GetDelegate();
-
-        if (operational_state_delegate != nullptr)
-        {
-            MutableCharSpan label(status_buffer);
-
-            operational_state_delegate->GetOperationalPhaseAtIndex(mPhase, label);
-
-            int length = snprintf((char *)NULL, 0, "%s (%s)", time_buffer, status_buffer) + 1; /* +1 for the null terminator */
-            status_formatted_buffer = (char *)malloc(length);
-            snprintf(status_formatted_buffer, length, "%s (%s)", time_buffer, status_buffer);
-
-            status_text = status_formatted_buffer;
-        }
+        view.hasPhase = true;
+        view.phase = mPhase;
     }
 
-    StatusDisplayMgr().UpdateDisplay(mIsShowingMenu, mOptedIntoEnergyManagement, mIsProgramSelected, mDelayedStartTimeRemaining, state_text, mode_text, status_text);
-
-    if (status_formatted_buffer != NULL)
-    {
-        free(status_formatted_buffer);
-    }
+    StatusDisplayMgr().UpdateDisplay(view);
 }
 
 void DishwasherManager::ProgressProgram()
@@ -408,105 +1601,95 @@ void DishwasherManager::ProgressProgram()
         return;
     }
 
-    // We might be on a delayed start, so tick down if required.
-    //
-    if (mDelayedStartTimeRemaining > 0)
+    uint64_t now = NowMs();
+
+    if (mIsPowerCapped && now >= mPowerCapEndMs)
     {
-        mDelayedStartTimeRemaining--;
-        UpdateDishwasherDisplay();
+        EndPowerCap();
     }
-    else
+
+    if (mIsEnergyPaused && now >= mEnergyPauseEndMs)
+    {
+        ResumeFromEnergyPause();
+    }
+
+    switch (mEngine.GetStage(now))
+    {
+    case ProgramEngine::Stage::kFinished:
+        EndProgram();
+        return;
+
+    case ProgramEngine::Stage::kRunning:
     {
-        // If we are stopped, we should start running.
+        // If we are stopped, the delayed start has expired and we should start running.
         //
         if (mState == OperationalStateEnum::kStopped)
         {
-            mState = OperationalStateEnum::kRunning;
-            UpdateOperationState(mState);
+            UpdateOperationState(OperationalStateEnum::kRunning);
         }
 
-        if (mState == OperationalStateEnum::kRunning)
+        uint8_t current_phase = to_underlying(GetWashProgram(mMode).steps[mEngine.GetStep(now)].phase);
+
+        // A cap still in force moves on to the next step with the program.
+        //
+        if (mIsPowerCapped && mEngine.GetStep(now) != mCappedStep.step)
         {
-            mRunningTimeRemaining--;
-
-            uint8_t current_phase = 0;
-
-            if (mRunningTimeRemaining <= 0)
-            {
-                current_phase = 0;
-                EndProgram();
-            }
-            else if (mRunningTimeRemaining < 5)
-            {
-                current_phase = 4;
-            }
-            else if (mRunningTimeRemaining < 10)
-            {
-                current_phase = 3;
-            }
-            else if (mRunningTimeRemaining < 15)
-            {
-                current_phase = 2;
-            }
-            else if (mRunningTimeRemaining < 20)
-            {
-                current_phase = 1;
-            }
+            CapCurrentStep(now);
+        }
 
+        if (current_phase != mPhase)
+        {
             UpdateCurrentPhase(current_phase);
         }
+        break;
     }
-}
 
-static void UpdateOperationalStatePhaseWorkHandler(intptr_t context)
-{
-    ESP_LOGI(TAG, "UpdateOperationalStatePhaseWorkHandler()");
-    DataModel::Nullable<uint8_t> phase = (DataModel::Nullable<uint8_t>)context;
-    OperationalState::GetInstance()->SetCurrentPhase(phase);
-    DishwasherMgr().UpdateDishwasherDisplay();
+    default:
+        break;
+    }
+
+    ArmProgramTimer();
 }
 
 void DishwasherManager::UpdateCurrentPhase(uint8_t phase)
 {
     mPhase = phase;
-
-    // This is one way to perform safe changes to the Matter stack.
-    //
-    chip::DeviceLayer::PlatformMgr().ScheduleWork(UpdateOperationalStatePhaseWorkHandler, mPhase);
-
-    // This is another.
-    //
-    // chip::DeviceLayer::PlatformMgr().LockChipStack();
-    // chip::DeviceLayer::PlatformMgr().UnlockChipStack();
-}
-
-static void UpdateOperationalStateWorkHandler(intptr_t context)
-{
-    ESP_LOGI(TAG, "UpdateOperationalStateWorkHandler()");
-    OperationalState::OperationalStateEnum state = (OperationalState::OperationalStateEnum)context;
-    OperationalState::GetInstance()->SetOperationalState(to_underlying(state));
-    OperationalState::GetInstance()->UpdateCountdownTimeFromDelegate();
-    DishwasherMgr().UpdateDishwasherDisplay();
+    MarkMatterDirty(MatterChangeSet::kCurrentPhase);
+    UpdatePowerAdjustment();
+    RequestDisplayUpdate();
 }
 
 void DishwasherManager::UpdateOperationState(OperationalStateEnum state)
 {
     mState = state;
-    chip::DeviceLayer::PlatformMgr().ScheduleWork(UpdateOperationalStateWorkHandler, (uint8_t)mState);
+    mIsCountdownReportForced = true;
+    MarkCheckpointDirty();
+    MarkMatterDirty(MatterChangeSet::kOperationalState);
+    UpdatePowerAdjustment();
+    RequestDisplayUpdate();
 }
 
+// A program runs the steps of the mode it was started in to the end, so the
+// mode can't change while one is selected. ChangeToMode is refused in that case
+// before it gets here, unless a program started in between, and then the
+// CurrentMode the server has already set is put back.
+//
 void DishwasherManager::UpdateMode(uint8_t mode)
 {
-    mMode = mode;
-    UpdateDishwasherDisplay();
-}
+    if (mIsProgramSelected)
+    {
+        ESP_LOGW(TAG, "Ignoring a mode change while a program is selected");
+        MarkMatterDirty(MatterChangeSet::kCurrentMode);
+        return;
+    }
 
-static void UpdateDishwasherCurrentModeWorkHandler(intptr_t context)
-{
-    ESP_LOGI(TAG, "UpdateOperationalStatePhaseWorkHandler()");
-    uint8_t mode = (uint8_t)context;
-    DishwasherMode::GetInstance()->UpdateCurrentMode(mode);
-    DishwasherMgr().UpdateDishwasherDisplay();
+    if (mode != mMode)
+    {
+        mMode = mode;
+        MarkMatterDirty(MatterChangeSet::kCurrentMode);
+    }
+
+    RequestDisplayUpdate();
 }
 
 void DishwasherManager::SelectNext()
@@ -517,25 +1700,19 @@ void DishwasherManager::SelectNext()
         return;
     }
 
+    if (HandleActivity())
+    {
+        return;
+    }
+
     if (mIsShowingMenu)
     {
         mOptedIntoEnergyManagement = !mOptedIntoEnergyManagement;
 
-        chip::DeviceLayer::PlatformMgr().LockChipStack();
-
-        if (mOptedIntoEnergyManagement)
-        {
-            device_energy_management_delegate.SetOptOutState(OptOutStateEnum::kNoOptOut);
-        }
-        else
-        {
-            device_energy_management_delegate.SetOptOutState(OptOutStateEnum::kOptOut);
-        }
-
-        chip::DeviceLayer::PlatformMgr().UnlockChipStack();
+        MarkMatterDirty(MatterChangeSet::kOptOutState);
 
         ESP_LOGI(TAG, "Opted into energy management: %d", mOptedIntoEnergyManagement);
-        UpdateDishwasherDisplay();
+        RequestDisplayUpdate();
     }
 }
 
@@ -547,25 +1724,19 @@ void DishwasherManager::SelectPrevious()
         return;
     }
 
+    if (HandleActivity())
+    {
+        return;
+    }
+
     if (mIsShowingMenu)
     {
         mOptedIntoEnergyManagement = !mOptedIntoEnergyManagement;
 
-        chip::DeviceLayer::PlatformMgr().LockChipStack();
-
-        if (mOptedIntoEnergyManagement)
-        {
-            device_energy_management_delegate.SetOptOutState(OptOutStateEnum::kNoOptOut);
-        }
-        else
-        {
-            device_energy_management_delegate.SetOptOutState(OptOutStateEnum::kOptOut);
-        }
-
-        chip::DeviceLayer::PlatformMgr().UnlockChipStack();
+        MarkMatterDirty(MatterChangeSet::kOptOutState);
 
         ESP_LOGI(TAG, "Opted into energy management: %d", mOptedIntoEnergyManagement);
-        UpdateDishwasherDisplay();
+        RequestDisplayUpdate();
     }
 }
 
@@ -577,15 +1748,20 @@ void DishwasherManager::HandleWheelClicked()
         return;
     }
 
+    if (HandleActivity())
+    {
+        return;
+    }
+
     if (mIsProgramSelected)
     {
         StopProgram();
-        UpdateDishwasherDisplay();
+        RequestDisplayUpdate();
     }
     else
     {
         mIsShowingMenu = !mIsShowingMenu;
-        UpdateDishwasherDisplay();
+        RequestDisplayUpdate();
     }
 }
 
@@ -609,14 +1785,14 @@ void DishwasherManager::SelectNextMode()
 
     // Roll over if we reach the end
     //
-    if (mMode > 2)
+    if (mMode >= kWashProgramCount)
     {
         mMode = 0;
     }
 
     ESP_LOGI(TAG, "Selected Mode: %d", mMode);
 
-    chip::DeviceLayer::PlatformMgr().ScheduleWork(UpdateDishwasherCurrentModeWorkHandler, mMode);
+    MarkMatterDirty(MatterChangeSet::kCurrentMode);
 }
 
 void DishwasherManager::SelectPreviousMode()
@@ -627,15 +1803,11 @@ void DishwasherManager::SelectPreviousMode()
         return;
     }
 
-    uint8_t current_mode = DishwasherMode::GetInstance()->GetCurrentMode();
-
-    ESP_LOGI(TAG, "Current Mode: %d", current_mode);
-
     // Roll over if we reach the start
     //
     if (mMode == 0)
     {
-        mMode = 2;
+        mMode = kWashProgramCount - 1;
     }
     else
     {
@@ -644,37 +1816,37 @@ void DishwasherManager::SelectPreviousMode()
 
     ESP_LOGI(TAG, "Selected Mode: %d", mMode);
 
-    chip::DeviceLayer::PlatformMgr().ScheduleWork(UpdateDishwasherCurrentModeWorkHandler, mMode);
-}
-
-static void UpdateForecastWorkHandler(intptr_t context)
-{
-    ESP_LOGI(TAG, "UpdateForecastWorkHandler()");
-    device_energy_management_delegate.SetForecast(DataModel::MakeNullable(sForecastStruct));
+    MarkMatterDirty(MatterChangeSet::kCurrentMode);
 }
 
+// Every change to the forecast is published under a new ID, which is what a
+// ModifyForecastRequest has to name. Changes made before the last one has been
+// published share its ID.
+//
 void DishwasherManager::SetForecast()
 {
-    ESP_LOGI(TAG, "DishwasherManager::SetForecast()");
+    if (!(mMatterChanges.dirty & MatterChangeSet::kForecast))
+    {
+        mForecast.forecastId = ++mLastForecastId;
+        MarkCheckpointDirty();
+    }
 
-    chip::DeviceLayer::PlatformMgr().ScheduleWork(UpdateForecastWorkHandler, mMode);
+    if (mForecast.slotCount > 0)
+    {
+        ChooseForecastResolution(mForecast, CONFIG_DISHWASHER_FORECAST_SIZE_BUDGET);
+        mPublishedActiveSlot = GetPublishedActiveSlot(mForecast);
+    }
 
-    // chip::DeviceLayer::PlatformMgr().LockChipStack();
-    // device_energy_management_delegate.SetForecast(DataModel::MakeNullable(sForecastStruct));
-    // chip::DeviceLayer::PlatformMgr().UnlockChipStack();
+    ESP_LOGI(TAG, "DishwasherManager::SetForecast(%lu)", mForecast.forecastId);
+
+    MarkMatterDirty(MatterChangeSet::kForecast);
 }
 
 void DishwasherManager::ClearForecast()
 {
     ESP_LOGI(TAG, "DishwasherManager::ClearForecast()");
 
-    sForecastStruct.startTime = 0;
-    sForecastStruct.endTime = 0;
-    sForecastStruct.earliestStartTime.ClearValue();
-    sForecastStruct.latestEndTime.ClearValue();
-    sForecastStruct.isPausable = false;
-    sForecastStruct.activeSlotNumber.SetNull();
-    sForecastStruct.slots = DataModel::List<const DeviceEnergyManagement::Structs::SlotStruct::Type>();
+    ResetForecast(mForecast);
 
     SetForecast();
-}
\ No newline at end of file
+}
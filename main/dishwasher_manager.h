@@ -1,15 +1,63 @@
 #include <lib/core/CHIPError.h>
 #include <app/clusters/operational-state-server/operational-state-server.h>
 
+#include <esp_timer.h>
+#include "sdkconfig.h"
+
+#include <atomic>
+
+#include "program_engine.h"
+#include "countdown_reporter.h"
+#include "program_store.h"
+#include "start_scheduler.h"
+#include "forecast_builder.h"
+#include "dishwasher_events.h"
+#include "dishwasher_matter.h"
+
 using namespace chip;
 using namespace chip::app;
 using namespace chip::app::Clusters;
 using namespace chip::app::Clusters::OperationalState;
 
+// What sets one dishwasher apart from another in the same process.
+//
+struct DishwasherConfig
+{
+    // NVS key for the program checkpoint, see ProgramStore.
+    //
+    const char *checkpointKey;
+
+    // The display, encoder, buttons and power management belong to one
+    // dishwasher. The others run headless.
+    //
+    bool hasFrontPanel;
+};
+
+// Everything below Init() runs on the dispatcher (see dishwasher_events.h).
+// Other tasks post an event instead, and may only call the Get* methods, which
+// read a copy published after each batch of events.
+//
+// DishwasherMgr() is the dishwasher with the front panel. app_main makes one
+// more for each extra endpoint (see DISHWASHER_ENDPOINT_COUNT), and the host
+// fleet simulator as many as it likes.
+//
 class DishwasherManager
 {
 public:
+    explicit DishwasherManager(const DishwasherConfig &config);
+
     esp_err_t Init();
+
+    void HandleEvent(const DishwasherEvent &event);
+    void FinishEvents();
+
+    // The dispatcher calls ScheduleFinish for each event, then FinishScheduled
+    // once the queue is empty, so each manager that had events finishes once.
+    // to_finish starts out null.
+    //
+    void ScheduleFinish(DishwasherManager *&to_finish);
+    static void FinishScheduled(DishwasherManager *&to_finish);
+
     void UpdateDishwasherDisplay();
 
     void UpdateOperationState(OperationalStateEnum state);
@@ -28,6 +76,9 @@ public:
     void HandleWheelClicked();
 
     OperationalStateEnum GetOperationalState();
+    bool IsProgramSelected();
+    bool IsProgramRunning();
+    bool IsWaitingToStart();
 
     uint32_t GetTimeRemaining();
 
@@ -51,28 +102,162 @@ public:
     void ClearForecast();
     void AdjustStartTime(uint32_t new_start_time);
 
+    bool PostTariff(const TariffCurve &tariff);
+    bool PostForecastAdjustment(const ForecastAdjustment &adjustment);
+    bool PostPowerCap(const PowerCap &cap);
+    bool PostCancelPowerCap();
+
+    void SleepDisplay();
+
+    // Counters only, so these are safe to read from any task.
+    //
+    uint32_t GetCountdownReportCount();
+    uint32_t GetCountdownSuppressedCount();
+    uint32_t GetCheckpointWriteCount();
+
 private:
     friend DishwasherManager &DishwasherMgr(void);
 
+    void StartUp();
+
     static DishwasherManager sDishwasher;
 
     void UpdateCurrentPhase(uint8_t phase);
 
-    OperationalState::OperationalStateEnum mState;
-    uint8_t mMode;
-    uint8_t mPhase;
-    uint32_t mRunningTimeRemaining;
-    uint32_t mDelayedStartTimeRemaining;
+    void ArmProgramTimer();
+    void RequestDisplayUpdate();
+    void PublishSnapshot();
+
+    void MarkMatterDirty(uint16_t attributes);
+    bool UpdateCountdownReport();
+
+    void ApplyTariff();
+    void ModifyForecast();
+
+    void StartPowerCap();
+    void EndPowerCap();
+    void CapCurrentStep(uint64_t now);
+    void ReleaseCappedStep(uint64_t now);
+    void UpdateCappedSlot();
+    void UpdatePowerAdjustment();
+
+    void PauseForEnergy(uint32_t duration);
+    void ResumeFromEnergyPause();
+    void UpdateEnergyState();
+    void UpdateForecastProgress(uint64_t now);
+
+    void RestoreProgram();
+    void CatchUpProgram();
+    void MarkCheckpointDirty();
+    bool UpdateCheckpoint();
+    void PublishMatterChanges();
+    void UpdatePowerState();
+    void UpdateDisplayRefresh();
+
+    void SetDisplayAwake(bool is_awake);
+    bool HandleActivity();
+
+    const bool mHasFrontPanel;
+
+    bool mIsFinishScheduled = false;
+    DishwasherManager *mNextToFinish = nullptr;
+
+    OperationalState::OperationalStateEnum mState = OperationalStateEnum::kStopped;
+    uint8_t mMode = 0;
+    uint8_t mPhase = 0;
+
+    ProgramEngine mEngine;
+    esp_timer_handle_t mProgramTimer = nullptr;
+    esp_timer_handle_t mDisplayRefreshTimer = nullptr;
+    bool mIsDisplayRefreshRunning = false;
+    esp_timer_handle_t mDisplaySleepTimer = nullptr;
+    bool mIsDisplayAwake = false;
     bool mOptedIntoEnergyManagement = false;
 
-    uint32_t mCurrentForecastId = 0;
-    uint32_t mForecastStartTime = 0;
+    ForecastPlan mForecast;
+
+    // Forecast IDs only ever go up, across programs and restarts. mForecastEndMs
+    // is when the published forecast has the program ending.
+    //
+    uint32_t mLastForecastId = 0;
+    uint64_t mForecastEndMs = 0;
+    uint8_t mPublishedActiveSlot = 0;
+
+    TariffCurve mTariff;
+    EventMailbox<TariffCurve> mTariffMailbox;
+    EventMailbox<ForecastAdjustment> mAdjustmentMailbox;
+    EventMailbox<PowerCap> mPowerCapMailbox;
+
+    // The PowerAdjustRequest in force, if any, and the step it is stretching.
+    // workMs is how long the step had left, at its nominal power, when the cap
+    // was applied at startMs.
+    //
+    // nominalPower and energy are the step's own, from before it was first
+    // capped. Once stretched, its forecast slot only shows the average power,
+    // so a later cap on the same step starts from these instead.
+    //
+    struct CappedStep
+    {
+        uint8_t step;
+        bool hasBaseline;
+        uint64_t startMs;
+        uint64_t workMs;
+        int64_t nominalPower;
+        int64_t power;
+        int64_t energy;
+    };
+
+    bool mIsPowerCapped = false;
+    PowerCap mPowerCap;
+    uint64_t mPowerCapEndMs = 0;
+    bool mIsStepCapped = false;
+    CappedStep mCappedStep = {};
+    PowerAdjustPlan mPowerAdjustment;
+
+    // A PauseRequest from an energy manager, which ends by itself.
+    //
+    bool mIsEnergyPaused = false;
+    uint64_t mEnergyPauseEndMs = 0;
+    EnergyState mEnergyState = EnergyState::kOnline;
 
     bool mIsShowingMenu = false;
     bool mIsProgramSelected = false;
 
     bool mIsPoweredOn = false;
     bool mIsShowingReset = false;
+
+    bool mIsDisplayDirty = false;
+    MatterChangeSet mMatterChanges;
+
+    CountdownReporter mCountdownReporter{CONFIG_DISHWASHER_COUNTDOWN_REPORT_INTERVAL, CONFIG_DISHWASHER_COUNTDOWN_REPORT_THRESHOLD};
+    bool mIsCountdownReportForced = false;
+
+    ProgramStore mProgramStore;
+    bool mIsCheckpointDirty = false;
+    uint64_t mLastCheckpointMs = 0;
+
+    // A program restored before the clock was set carries on from its
+    // checkpoint, and makes up the time the device was off once it is. The
+    // checkpoint was saved at mCatchUpSavedAt, and restored at mCatchUpFromMs.
+    //
+    bool mIsCatchUpPending = false;
+    uint32_t mCatchUpSavedAt = 0;
+    uint64_t mCatchUpFromMs = 0;
+
+    // What the Get* methods return to other tasks, guarded by a sequence count
+    // that is odd while the dispatcher is writing it.
+    //
+    struct Snapshot
+    {
+        OperationalStateEnum state;
+        uint8_t mode;
+        ProgramEngine engine;
+    };
+
+    Snapshot mSnapshot = {};
+    std::atomic<uint32_t> mSnapshotSequence{0};
+
+    Snapshot ReadSnapshot();
 };
 
 inline DishwasherManager &DishwasherMgr(void)
@@ -0,0 +1,387 @@
+#define DISHWASHER_LOG_LEVEL CONFIG_DISHWASHER_LOG_LEVEL_MATTER
+#include "dishwasher_log.h"
+
+#include "dishwasher_matter.h"
+
+#include <esp_matter.h>
+
+#include <app/clusters/operational-state-server/operational-state-server.h>
+#include <app/clusters/mode-base-server/mode-base-server.h>
+
+#include <atomic>
+
+#include "app_priv.h"
+#include "dishwasher_events.h"
+#include "boot_profiler.h"
+
+static const char *TAG = "dishwasher_matter";
+
+using namespace chip;
+using namespace chip::app;
+using namespace chip::app::Clusters;
+using namespace chip::app::Clusters::OperationalState;
+
+static DeviceEnergyManagement::ForecastUpdateReasonEnum ToForecastUpdateReason(ForecastReason reason)
+{
+    switch (reason)
+    {
+    case ForecastReason::kLocalOptimization:
+        return DeviceEnergyManagement::ForecastUpdateReasonEnum::kLocalOptimization;
+    case ForecastReason::kGridOptimization:
+        return DeviceEnergyManagement::ForecastUpdateReasonEnum::kGridOptimization;
+    default:
+        return DeviceEnergyManagement::ForecastUpdateReasonEnum::kInternalOptimization;
+    }
+}
+
+// What each dishwasher (see DishwasherEndpoint) is publishing, in the same
+// order as GetDishwasherEndpoint.
+//
+// Changes from DishwasherManager arrive on its dispatcher task as a change set,
+// once per batch of events. The whole set is handed over to the Matter thread
+// with one ScheduleWork, so the dispatcher never takes the CHIP stack lock.
+// inFlight belongs to the Matter thread from the moment isPublishInFlight is
+// set until the work handler clears it.
+//
+// As with the forecast, the power adjustment capability's list points at
+// powerAdjustments.
+//
+struct MatterPublisher
+{
+    MatterChangeSet inFlight;
+    std::atomic<bool> isPublishInFlight{false};
+    std::atomic<bool> isPublishWanted{false};
+
+    DeviceEnergyManagement::Structs::PowerAdjustStruct::Type powerAdjustments[1];
+    DeviceEnergyManagement::Structs::PowerAdjustCapabilityStruct::Type powerAdjustCapability;
+};
+
+static MatterPublisher sPublishers[CONFIG_DISHWASHER_ENDPOINT_COUNT];
+static std::atomic<bool> sIsServerReady{false};
+
+// Runs on the Matter thread. The forecast is built in the delegate's back
+// buffer and swapped in, so the published one is never written to.
+//
+static void UpdateForecast(DishwasherEndpoint &dishwasher, const ForecastPlan &plan)
+{
+    DeviceEnergyManagement::DeviceEnergyManagementDelegate &delegate = dishwasher.energyDelegate;
+    ForecastStore::Buffer &buffer = delegate.GetForecastStore().GetBackBuffer();
+
+    // Without a program there is no forecast.
+    //
+    if (plan.slotCount == 0)
+    {
+        buffer.forecast.SetNull();
+        delegate.PublishForecast();
+        return;
+    }
+
+    DeviceEnergyManagement::Structs::ForecastStruct::Type &forecast = buffer.forecast.SetNonNull();
+    DeviceEnergyManagement::Structs::SlotStruct::Type *slots = buffer.slots;
+
+    forecast.forecastID = plan.forecastId;
+    forecast.startTime = plan.startTime;
+    forecast.endTime = plan.endTime;
+    forecast.forecastUpdateReason = ToForecastUpdateReason(plan.reason);
+
+    if (plan.hasTimeWindow)
+    {
+        forecast.earliestStartTime = MakeOptional(plan.earliestStartTime);
+        forecast.latestEndTime = MakeOptional(plan.latestEndTime);
+    }
+    else
+    {
+        forecast.earliestStartTime.ClearValue();
+        forecast.latestEndTime.ClearValue();
+    }
+
+    forecast.isPausable = plan.isPausable;
+
+    if (plan.hasActiveSlot)
+    {
+        forecast.activeSlotNumber.SetNonNull(GetPublishedActiveSlot(plan));
+    }
+    else
+    {
+        forecast.activeSlotNumber.SetNull();
+    }
+
+    // Each of the plan's slots may be published as several.
+    //
+    uint8_t count = 0;
+
+    for (uint8_t step = 0; step < plan.slotCount; step++)
+    {
+        uint8_t parts = GetForecastSlotParts(plan, step);
+
+        for (uint8_t part = 0; part < parts && count < kMaxPublishedSlots; part++)
+        {
+            uint8_t i = count++;
+            const ForecastPlanSlot slot = GetForecastSlotPart(plan, step, part);
+
+            slots[i].minDuration = slot.minDuration;
+            slots[i].maxDuration = slot.maxDuration;
+            slots[i].defaultDuration = slot.defaultDuration;
+            slots[i].elapsedSlotTime = slot.elapsedTime;
+            slots[i].remainingSlotTime = slot.remainingTime;
+
+            slots[i].slotIsPausable.SetValue(slot.isPausable);
+
+            if (slot.isPausable)
+            {
+                slots[i].minPauseDuration.SetValue(slot.minPauseDuration);
+                slots[i].maxPauseDuration.SetValue(slot.maxPauseDuration);
+            }
+            else
+            {
+                slots[i].minPauseDuration.ClearValue();
+                slots[i].maxPauseDuration.ClearValue();
+            }
+
+            slots[i].nominalPower.SetValue(slot.nominalPower);
+            slots[i].minPower.SetValue(slot.minPower);
+            slots[i].maxPower.SetValue(slot.maxPower);
+
+            // What a ModifyForecastRequest may change the slot to. The cluster server
+            // checks requests against these before they reach us.
+            //
+            slots[i].minDurationAdjustment.SetValue(slot.minDuration);
+            slots[i].maxDurationAdjustment.SetValue(slot.maxDuration);
+            slots[i].minPowerAdjustment.SetValue(slot.minPower);
+            slots[i].maxPowerAdjustment.SetValue(slot.maxPower);
+        }
+    }
+
+    forecast.slots = DataModel::List<DeviceEnergyManagement::Structs::SlotStruct::Type>(slots, count);
+
+    delegate.PublishForecast();
+}
+
+static DeviceEnergyManagement::PowerAdjustReasonEnum ToPowerAdjustReason(const PowerAdjustPlan &plan)
+{
+    if (!plan.isActive)
+    {
+        return DeviceEnergyManagement::PowerAdjustReasonEnum::kNoAdjustment;
+    }
+
+    if (plan.cause == ForecastReason::kGridOptimization)
+    {
+        return DeviceEnergyManagement::PowerAdjustReasonEnum::kGridOptimizationAdjustment;
+    }
+
+    return DeviceEnergyManagement::PowerAdjustReasonEnum::kLocalOptimizationAdjustment;
+}
+
+static void UpdatePowerAdjustment(DishwasherEndpoint &dishwasher, const PowerAdjustPlan &plan)
+{
+    MatterPublisher &publisher = sPublishers[dishwasher.index];
+    DeviceEnergyManagement::Structs::PowerAdjustCapabilityStruct::Type &capability = publisher.powerAdjustCapability;
+
+    if (plan.isAvailable)
+    {
+        publisher.powerAdjustments[0].minPower = plan.minPower;
+        publisher.powerAdjustments[0].maxPower = plan.maxPower;
+        publisher.powerAdjustments[0].minDuration = plan.minDuration;
+        publisher.powerAdjustments[0].maxDuration = plan.maxDuration;
+
+        capability.powerAdjustCapability.SetNonNull(DataModel::List<const DeviceEnergyManagement::Structs::PowerAdjustStruct::Type>(publisher.powerAdjustments, 1));
+    }
+    else
+    {
+        capability.powerAdjustCapability.SetNull();
+    }
+
+    capability.cause = ToPowerAdjustReason(plan);
+
+    dishwasher.energyDelegate.SetPowerAdjustmentCapability(DataModel::MakeNullable(capability));
+}
+
+static DeviceEnergyManagement::ESAStateEnum ToESAState(EnergyState state)
+{
+    switch (state)
+    {
+    case EnergyState::kPowerAdjustActive:
+        return DeviceEnergyManagement::ESAStateEnum::kPowerAdjustActive;
+    case EnergyState::kPaused:
+        return DeviceEnergyManagement::ESAStateEnum::kPaused;
+    default:
+        return DeviceEnergyManagement::ESAStateEnum::kOnline;
+    }
+}
+
+static void UpdateOnOff(uint16_t endpoint_id, bool on)
+{
+    // We can update the OnOff attribute directly as its managed by esp-matter.
+    //
+    uint32_t cluster_id = OnOff::Id;
+    uint32_t attribute_id = OnOff::Attributes::OnOff::Id;
+
+    esp_matter::attribute_t *attribute = esp_matter::attribute::get(endpoint_id, cluster_id, attribute_id);
+
+    esp_matter_attr_val_t val = esp_matter_invalid(NULL);
+    esp_matter::attribute::get_val(attribute, &val);
+    val.val.b = on;
+    esp_matter::attribute::update(endpoint_id, cluster_id, attribute_id, &val);
+}
+
+static void PublishChangesWorkHandler(intptr_t context)
+{
+    DishwasherEndpoint &dishwasher = *reinterpret_cast<DishwasherEndpoint *>(context);
+    MatterPublisher &publisher = sPublishers[dishwasher.index];
+    DeviceEnergyManagement::DeviceEnergyManagementDelegate &energy_delegate = dishwasher.energyDelegate;
+
+    const MatterChangeSet &changes = publisher.inFlight;
+
+    ESP_LOGD(TAG, "PublishChangesWorkHandler(%d, 0x%03x)", dishwasher.endpointId, changes.dirty);
+
+    // The instances are made by the cluster init callbacks, before the server is
+    // ready, but a cluster that failed to come up leaves its instance null.
+    //
+    OperationalState::Instance *operational_state = dishwasher.operationalStateInstance;
+    ModeBase::Instance *mode = dishwasher.modeInstance;
+
+    if (operational_state != nullptr && (changes.dirty & MatterChangeSet::kOperationalState))
+    {
+        operational_state->SetOperationalState(to_underlying(changes.operationalState));
+    }
+
+    if (operational_state != nullptr && (changes.dirty & MatterChangeSet::kCurrentPhase))
+    {
+        operational_state->SetCurrentPhase(DataModel::Nullable<uint8_t>(changes.currentPhase));
+    }
+
+    if (operational_state != nullptr && (changes.dirty & MatterChangeSet::kCountdownTime))
+    {
+        operational_state->UpdateCountdownTimeFromDelegate();
+    }
+
+    if (mode != nullptr && (changes.dirty & MatterChangeSet::kCurrentMode))
+    {
+        mode->UpdateCurrentMode(changes.currentMode);
+    }
+
+    if (changes.dirty & MatterChangeSet::kOnOff)
+    {
+        UpdateOnOff(dishwasher.endpointId, changes.onOff);
+    }
+
+    if (changes.dirty & MatterChangeSet::kOptOutState)
+    {
+        if (changes.optedIn)
+        {
+            energy_delegate.SetOptOutState(DeviceEnergyManagement::OptOutStateEnum::kNoOptOut);
+        }
+        else
+        {
+            energy_delegate.SetOptOutState(DeviceEnergyManagement::OptOutStateEnum::kOptOut);
+        }
+    }
+
+    if (changes.dirty & MatterChangeSet::kForecast)
+    {
+        UpdateForecast(dishwasher, changes.forecast);
+    }
+
+    if (changes.dirty & MatterChangeSet::kPowerAdjustment)
+    {
+        UpdatePowerAdjustment(dishwasher, changes.powerAdjustment);
+    }
+
+    if (changes.dirty & MatterChangeSet::kEnergyState)
+    {
+        energy_delegate.SetESAState(ToESAState(changes.energyState));
+    }
+
+    // Once the server is up, attributes marked dirty here go out to subscribers.
+    //
+    if (BootProfilerGetTime(BootStage::kServerReady) != 0)
+    {
+        BootProfilerMark(BootStage::kFirstReport);
+    }
+
+    publisher.isPublishInFlight.store(false, std::memory_order_release);
+
+    // The dispatcher was turned away while this ran, so let it publish what it has now.
+    //
+    if (publisher.isPublishWanted.exchange(false))
+    {
+        DishwasherPostEvent(dishwasher.manager, DishwasherEventType::kMatterPublished);
+    }
+}
+
+bool MatterPublishChanges(DishwasherManager &manager, const MatterChangeSet &changes)
+{
+    DishwasherEndpoint *dishwasher = FindDishwasherEndpoint(manager);
+
+    // A manager without an endpoint has nowhere to publish to.
+    //
+    if (dishwasher == nullptr)
+    {
+        return true;
+    }
+
+    MatterPublisher &publisher = sPublishers[dishwasher->index];
+
+    // Ask for a retry first, so a handler finishing between here and the check
+    // below still sees it.
+    //
+    publisher.isPublishWanted.store(true);
+
+    if (!sIsServerReady.load() || publisher.isPublishInFlight.load(std::memory_order_acquire))
+    {
+        return false;
+    }
+
+    publisher.isPublishWanted.store(false);
+
+    publisher.inFlight = changes;
+    publisher.isPublishInFlight.store(true, std::memory_order_release);
+
+    if (chip::DeviceLayer::PlatformMgr().ScheduleWork(PublishChangesWorkHandler, reinterpret_cast<intptr_t>(dishwasher)) != CHIP_NO_ERROR)
+    {
+        ESP_LOGW(TAG, "Failed to schedule the Matter attribute update for endpoint %d", dishwasher->endpointId);
+        publisher.isPublishInFlight.store(false, std::memory_order_release);
+        return false;
+    }
+
+    return true;
+}
+
+void MatterServerReady()
+{
+    sIsServerReady.store(true);
+
+    // A publish that was turned away before the server was ready left its
+    // isPublishWanted set.
+    //
+    for (uint8_t i = 0; i < GetDishwasherEndpointCount(); i++)
+    {
+        DishwasherEndpoint &dishwasher = GetDishwasherEndpoint(i);
+
+        if (sPublishers[dishwasher.index].isPublishWanted.exchange(false))
+        {
+            DishwasherPostEvent(dishwasher.manager, DishwasherEventType::kMatterPublished);
+        }
+    }
+}
+
+void MatterFactoryReset()
+{
+    esp_matter::factory_reset();
+}
+
+uint32_t MatterGetEpochTime()
+{
+    // Get the current time the CHIP way...
+    //
+    System::Clock::Microseconds64 utcTime;
+
+    // Zero until the time has been synchronised.
+    //
+    if (chip::System::SystemClock().GetClock_RealTime(utcTime) != CHIP_NO_ERROR)
+    {
+        return 0;
+    }
+
+    return std::chrono::duration_cast<chip::System::Clock::Seconds32>(utcTime).count();
+}
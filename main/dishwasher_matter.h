@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <app/clusters/operational-state-server/operational-state-server.h>
+
+#include "forecast_builder.h"
+
+class DishwasherManager;
+
+// Everything DishwasherManager needs from the Matter stack.
+//
+// On the device these are implemented in dishwasher_matter.cpp, which hands
+// the changes over to the Matter thread. The host simulator in host/ provides
+// its own implementation, so DishwasherManager never touches the SDK directly.
+//
+
+// The DeviceEnergyManagement ESAState, as far as the dishwasher is concerned.
+//
+enum class EnergyState : uint8_t
+{
+    kOnline,
+    kPowerAdjustActive,
+    kPaused,
+};
+
+// The attributes DishwasherManager has changed since it last published, with
+// their latest values. However many times an attribute changes in between,
+// it is only written (and reported) once.
+//
+struct MatterChangeSet
+{
+    enum Attribute : uint16_t
+    {
+        kOperationalState = 1 << 0,
+        kCurrentPhase = 1 << 1,
+        kCountdownTime = 1 << 2,
+        kCurrentMode = 1 << 3,
+        kOnOff = 1 << 4,
+        kOptOutState = 1 << 5,
+        kForecast = 1 << 6,
+        kPowerAdjustment = 1 << 7,
+        kEnergyState = 1 << 8,
+    };
+
+    uint16_t dirty = 0;
+
+    chip::app::Clusters::OperationalState::OperationalStateEnum operationalState = chip::app::Clusters::OperationalState::OperationalStateEnum::kStopped;
+    uint8_t currentPhase = 0;
+    uint8_t currentMode = 0;
+    bool onOff = false;
+    bool optedIn = false;
+    ForecastPlan forecast;
+    PowerAdjustPlan powerAdjustment;
+    EnergyState energyState = EnergyState::kOnline;
+};
+
+// Applies every dirty attribute in the change set to the manager's endpoints on
+// the Matter thread, in a single hop. Returns false, without taking the
+// changes, while an earlier publish for the same manager is still being
+// applied. A DishwasherEventType::kMatterPublished event is then posted to it
+// once it has been, so it can try again.
+//
+bool MatterPublishChanges(DishwasherManager &manager, const MatterChangeSet &changes);
+
+// Called on the Matter thread once the server is ready. Until then the cluster
+// instances may not exist, so MatterPublishChanges holds every change, and any
+// dishwasher with changes waiting is asked to publish them now.
+//
+void MatterServerReady();
+
+void MatterFactoryReset();
+
+// Seconds since the Unix epoch, as known to the Matter stack.
+//
+uint32_t MatterGetEpochTime();
@@ -0,0 +1,426 @@
+#include "forecast_builder.h"
+
+// The resolutions ChooseForecastResolution tries, finest first.
+//
+static constexpr uint32_t kForecastResolutions[] = {Minutes(5), Minutes(10), Minutes(15), Minutes(30)};
+
+void BuildForecast(const WashProgram &program, uint32_t startTime, ForecastPlan &plan)
+{
+    bool is_pausable = false;
+
+    // Each step of the program becomes one slot in the forecast.
+    //
+    for (uint8_t i = 0; i < program.stepCount; i++)
+    {
+        const WashStep &step = program.steps[i];
+        ForecastPlanSlot &slot = plan.slots[i];
+
+        // A step needs the same energy whatever its power, so it can run as
+        // fast as its maximum power allows, or as slowly as its minimum.
+        //
+        slot.minDuration = (uint32_t)((step.duration * step.nominalPower + step.maxPower - 1) / step.maxPower);
+        slot.maxDuration = (uint32_t)(step.duration * step.nominalPower / step.minPower);
+        slot.defaultDuration = step.duration;
+
+        slot.nominalPower = step.nominalPower;
+        slot.minPower = step.minPower;
+        slot.maxPower = step.maxPower;
+
+        slot.elapsedTime = 0;
+        slot.remainingTime = step.duration;
+
+        slot.isPausable = step.isPausable;
+        slot.minPauseDuration = step.isPausable ? kMinPauseDuration : 0;
+        slot.maxPauseDuration = step.isPausable ? kMaxPauseDuration : 0;
+
+        is_pausable = is_pausable || step.isPausable;
+    }
+
+    plan.slotCount = program.stepCount;
+    plan.isPausable = is_pausable;
+    plan.hasActiveSlot = false;
+    plan.slotResolution = 0;
+    plan.hasTimeWindow = false;
+    plan.reason = ForecastReason::kInternalOptimization;
+
+    SetForecastStartTime(plan, startTime);
+}
+
+void SetForecastStartTime(ForecastPlan &plan, uint32_t startTime)
+{
+    plan.startTime = startTime;
+    plan.endTime = startTime + GetForecastDuration(plan);
+}
+
+void SetForecastTimeWindow(ForecastPlan &plan, uint32_t earliestStartTime, uint32_t latestEndTime)
+{
+    plan.hasTimeWindow = true;
+    plan.earliestStartTime = earliestStartTime;
+    plan.latestEndTime = latestEndTime;
+}
+
+void ResetForecast(ForecastPlan &plan)
+{
+    plan.startTime = 0;
+    plan.endTime = 0;
+    plan.hasTimeWindow = false;
+    plan.isPausable = false;
+    plan.hasActiveSlot = false;
+    plan.slotResolution = 0;
+    plan.slotCount = 0;
+}
+
+bool IsValidForecastAdjustment(const ForecastPlan &plan, const ForecastAdjustment &adjustment)
+{
+    for (uint8_t i = 0; i < adjustment.count; i++)
+    {
+        const ForecastSlotAdjustment &slot_adjustment = adjustment.slots[i];
+
+        if (slot_adjustment.slotIndex >= plan.slotCount)
+        {
+            return false;
+        }
+
+        const ForecastPlanSlot &slot = plan.slots[slot_adjustment.slotIndex];
+
+        if (slot_adjustment.duration < slot.minDuration || slot_adjustment.duration > slot.maxDuration)
+        {
+            return false;
+        }
+
+        if (slot_adjustment.hasNominalPower && (slot_adjustment.nominalPower < slot.minPower || slot_adjustment.nominalPower > slot.maxPower))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void ApplyForecastAdjustment(ForecastPlan &plan, const ForecastAdjustment &adjustment)
+{
+    for (uint8_t i = 0; i < adjustment.count; i++)
+    {
+        const ForecastSlotAdjustment &slot_adjustment = adjustment.slots[i];
+        ForecastPlanSlot &slot = plan.slots[slot_adjustment.slotIndex];
+
+        slot.defaultDuration = slot_adjustment.duration;
+
+        if (slot_adjustment.hasNominalPower)
+        {
+            slot.nominalPower = slot_adjustment.nominalPower;
+        }
+    }
+
+    plan.reason = adjustment.reason;
+
+    SetForecastStartTime(plan, plan.startTime);
+}
+
+uint32_t GetForecastDuration(const ForecastPlan &plan)
+{
+    uint32_t duration = 0;
+
+    for (uint8_t i = 0; i < plan.slotCount; i++)
+    {
+        duration += plan.slots[i].defaultDuration;
+    }
+
+    return duration;
+}
+
+uint8_t GetForecastSlotParts(const ForecastPlan &plan, uint8_t slotIndex)
+{
+    uint32_t duration = plan.slots[slotIndex].defaultDuration;
+
+    if (plan.slotResolution == 0 || duration <= plan.slotResolution)
+    {
+        return 1;
+    }
+
+    uint32_t parts = (duration + plan.slotResolution - 1) / plan.slotResolution;
+
+    return parts > kMaxPublishedSlots ? kMaxPublishedSlots + 1 : (uint8_t)parts;
+}
+
+ForecastPlanSlot GetForecastSlotPart(const ForecastPlan &plan, uint8_t slotIndex, uint8_t part)
+{
+    const ForecastPlanSlot &slot = plan.slots[slotIndex];
+    uint8_t parts = GetForecastSlotParts(plan, slotIndex);
+
+    if (parts == 1)
+    {
+        return slot;
+    }
+
+    // Every part but the last is slotResolution long.
+    //
+    uint32_t offset = part * plan.slotResolution;
+    uint32_t duration = part + 1 < parts ? plan.slotResolution : slot.defaultDuration - offset;
+
+    ForecastPlanSlot published = slot;
+
+    published.defaultDuration = duration;
+    published.minDuration = (uint32_t)(((uint64_t)slot.minDuration * duration + slot.defaultDuration - 1) / slot.defaultDuration);
+    published.maxDuration = (uint32_t)((uint64_t)slot.maxDuration * duration / slot.defaultDuration);
+
+    if (published.maxDuration < published.minDuration)
+    {
+        published.maxDuration = published.minDuration;
+    }
+
+    uint32_t elapsed = slot.elapsedTime > offset ? slot.elapsedTime - offset : 0;
+
+    published.elapsedTime = elapsed < duration ? elapsed : duration;
+    published.remainingTime = duration - published.elapsedTime;
+
+    return published;
+}
+
+uint8_t GetPublishedSlotCount(const ForecastPlan &plan)
+{
+    uint32_t count = 0;
+
+    for (uint8_t i = 0; i < plan.slotCount; i++)
+    {
+        count += GetForecastSlotParts(plan, i);
+    }
+
+    return count > kMaxPublishedSlots ? kMaxPublishedSlots + 1 : (uint8_t)count;
+}
+
+uint8_t GetPublishedSlotIndex(const ForecastPlan &plan, uint8_t slotIndex, uint32_t elapsed)
+{
+    uint32_t index = 0;
+
+    for (uint8_t i = 0; i < slotIndex && i < plan.slotCount; i++)
+    {
+        index += GetForecastSlotParts(plan, i);
+    }
+
+    if (plan.slotResolution > 0 && slotIndex < plan.slotCount)
+    {
+        uint32_t part = elapsed / plan.slotResolution;
+        uint8_t parts = GetForecastSlotParts(plan, slotIndex);
+
+        index += part < parts ? part : parts - 1;
+    }
+
+    return index > UINT8_MAX ? UINT8_MAX : (uint8_t)index;
+}
+
+uint8_t GetPublishedActiveSlot(const ForecastPlan &plan)
+{
+    if (!plan.hasActiveSlot)
+    {
+        return 0;
+    }
+
+    return GetPublishedSlotIndex(plan, plan.activeSlotNumber, plan.slots[plan.activeSlotNumber].elapsedTime);
+}
+
+// TLV puts each integer in the fewest bytes that hold its value.
+//
+static size_t GetTlvIntegerSize(int64_t value)
+{
+    if (value >= INT8_MIN && value <= UINT8_MAX)
+    {
+        return 1;
+    }
+
+    if (value >= INT16_MIN && value <= UINT16_MAX)
+    {
+        return 2;
+    }
+
+    if (value >= INT32_MIN && value <= UINT32_MAX)
+    {
+        return 4;
+    }
+
+    return 8;
+}
+
+// A control byte and a one byte context tag, then the value.
+//
+static size_t GetTlvFieldSize(int64_t value)
+{
+    return 2 + GetTlvIntegerSize(value);
+}
+
+static size_t EstimateSlotSize(const ForecastPlanSlot &slot)
+{
+    // The anonymous structure's control byte and end of container.
+    //
+    size_t size = 2;
+
+    size += GetTlvFieldSize(slot.minDuration);
+    size += GetTlvFieldSize(slot.maxDuration);
+    size += GetTlvFieldSize(slot.defaultDuration);
+    size += GetTlvFieldSize(slot.elapsedTime);
+    size += GetTlvFieldSize(slot.remainingTime);
+
+    // A boolean is held in its control byte.
+    //
+    size += 2;
+
+    if (slot.isPausable)
+    {
+        size += GetTlvFieldSize(slot.minPauseDuration);
+        size += GetTlvFieldSize(slot.maxPauseDuration);
+    }
+
+    size += GetTlvFieldSize(slot.nominalPower);
+    size += GetTlvFieldSize(slot.minPower);
+    size += GetTlvFieldSize(slot.maxPower);
+
+    // The duration and power adjustment limits.
+    //
+    size += GetTlvFieldSize(slot.minDuration);
+    size += GetTlvFieldSize(slot.maxDuration);
+    size += GetTlvFieldSize(slot.minPower);
+    size += GetTlvFieldSize(slot.maxPower);
+
+    return size;
+}
+
+size_t EstimateForecastSize(const ForecastPlan &plan)
+{
+    // The attribute's structure, its forecast ID, active slot, start and end
+    // times, the optional time window, isPausable and the update reason.
+    //
+    size_t size = 2;
+
+    size += GetTlvFieldSize(plan.forecastId);
+    size += plan.hasActiveSlot ? GetTlvFieldSize(GetPublishedActiveSlot(plan)) : 2;
+    size += GetTlvFieldSize(plan.startTime);
+    size += GetTlvFieldSize(plan.endTime);
+
+    if (plan.hasTimeWindow)
+    {
+        size += GetTlvFieldSize(plan.earliestStartTime);
+        size += GetTlvFieldSize(plan.latestEndTime);
+    }
+
+    size += 2;
+    size += GetTlvFieldSize((int64_t)plan.reason);
+
+    // The slot list's tag and end of container.
+    //
+    size += 3;
+
+    for (uint8_t i = 0; i < plan.slotCount; i++)
+    {
+        uint8_t parts = GetForecastSlotParts(plan, i);
+
+        for (uint8_t part = 0; part < parts; part++)
+        {
+            size += EstimateSlotSize(GetForecastSlotPart(plan, i, part));
+        }
+    }
+
+    return size;
+}
+
+void ChooseForecastResolution(ForecastPlan &plan, size_t budget)
+{
+    for (uint32_t resolution : kForecastResolutions)
+    {
+        plan.slotResolution = resolution;
+
+        if (GetPublishedSlotCount(plan) <= kMaxPublishedSlots && EstimateForecastSize(plan) <= budget)
+        {
+            return;
+        }
+    }
+
+    plan.slotResolution = 0;
+}
+
+bool HasRepeatedForecastSlot(const ForecastAdjustment &adjustment)
+{
+    for (uint8_t i = 1; i < adjustment.count; i++)
+    {
+        for (uint8_t j = 0; j < i; j++)
+        {
+            if (adjustment.slots[i].slotIndex == adjustment.slots[j].slotIndex)
+            {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+bool CollapseForecastAdjustment(const ForecastPlan &plan, const ForecastAdjustment &published, ForecastAdjustment &adjustment)
+{
+    // Each part replaces what the slot had, so a part named twice would be
+    // taken out of the slot twice.
+    //
+    if (HasRepeatedForecastSlot(published))
+    {
+        return false;
+    }
+
+    uint32_t durations[kMaxForecastSlots];
+    int64_t energies[kMaxForecastSlots];
+    bool is_adjusted[kMaxForecastSlots] = {};
+    bool has_nominal_power[kMaxForecastSlots] = {};
+
+    for (uint8_t i = 0; i < plan.slotCount; i++)
+    {
+        durations[i] = plan.slots[i].defaultDuration;
+        energies[i] = plan.slots[i].nominalPower * plan.slots[i].defaultDuration;
+    }
+
+    for (uint8_t i = 0; i < published.count; i++)
+    {
+        const ForecastSlotAdjustment &published_slot = published.slots[i];
+
+        // Find the plan's slot and part the published slot was made from.
+        //
+        uint8_t index = published_slot.slotIndex;
+        uint8_t slot_index = 0;
+
+        while (slot_index < plan.slotCount && index >= GetForecastSlotParts(plan, slot_index))
+        {
+            index -= GetForecastSlotParts(plan, slot_index);
+            slot_index++;
+        }
+
+        if (slot_index >= plan.slotCount)
+        {
+            return false;
+        }
+
+        ForecastPlanSlot part = GetForecastSlotPart(plan, slot_index, index);
+        int64_t power = published_slot.hasNominalPower ? published_slot.nominalPower : part.nominalPower;
+
+        durations[slot_index] = durations[slot_index] - part.defaultDuration + published_slot.duration;
+        energies[slot_index] += power * published_slot.duration - part.nominalPower * part.defaultDuration;
+        is_adjusted[slot_index] = true;
+        has_nominal_power[slot_index] = has_nominal_power[slot_index] || published_slot.hasNominalPower;
+    }
+
+    adjustment.forecastId = published.forecastId;
+    adjustment.reason = published.reason;
+    adjustment.count = 0;
+
+    for (uint8_t i = 0; i < plan.slotCount; i++)
+    {
+        if (!is_adjusted[i])
+        {
+            continue;
+        }
+
+        ForecastSlotAdjustment &slot_adjustment = adjustment.slots[adjustment.count++];
+
+        slot_adjustment.slotIndex = i;
+        slot_adjustment.duration = durations[i];
+        slot_adjustment.hasNominalPower = has_nominal_power[i] && durations[i] > 0;
+        slot_adjustment.nominalPower = slot_adjustment.hasNominalPower ? energies[i] / durations[i] : 0;
+    }
+
+    return true;
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "wash_programs.h"
+
+// A plain description of the DeviceEnergyManagement forecast for a program.
+//
+// This is what DishwasherManager builds and reasons about. It is only turned
+// into the Matter ForecastStruct when it is handed to the Matter stack, which
+// keeps the forecast logic free of the Matter SDK types.
+//
+constexpr uint8_t kMaxForecastSlots = kMaxWashSteps;
+
+// The plan has one slot per step, but each step can be published as several
+// slots of slotResolution seconds, for a finer grained profile. This is the
+// most that are published.
+//
+constexpr uint8_t kMaxPublishedSlots = 24;
+
+enum class ForecastReason : uint8_t
+{
+    kInternalOptimization,
+    kLocalOptimization,
+    kGridOptimization,
+};
+
+struct ForecastPlanSlot
+{
+    uint32_t minDuration;
+    uint32_t maxDuration;
+    uint32_t defaultDuration;
+    int64_t nominalPower;
+    int64_t minPower;
+    int64_t maxPower;
+
+    bool isPausable;
+    uint32_t minPauseDuration;
+    uint32_t maxPauseDuration;
+
+    // How far the program has got through the slot, as last published.
+    //
+    uint32_t elapsedTime;
+    uint32_t remainingTime;
+};
+
+struct ForecastPlan
+{
+    uint32_t forecastId = 0;
+    uint32_t startTime = 0;
+    uint32_t endTime = 0;
+
+    bool hasTimeWindow = false;
+    uint32_t earliestStartTime = 0;
+    uint32_t latestEndTime = 0;
+
+    bool isPausable = false;
+    ForecastReason reason = ForecastReason::kInternalOptimization;
+
+    // The slot being run, once the program has started.
+    //
+    bool hasActiveSlot = false;
+    uint8_t activeSlotNumber = 0;
+
+    // Seconds per published slot, or 0 to publish each slot as it is.
+    //
+    uint32_t slotResolution = 0;
+
+    uint8_t slotCount = 0;
+    ForecastPlanSlot slots[kMaxForecastSlots] = {};
+};
+
+// A change an energy manager has asked for with ModifyForecastRequest. Each
+// slot can be given a new duration and, optionally, a new nominal power. The
+// request names published slots, which CollapseForecastAdjustment turns into
+// slots of the plan.
+//
+struct ForecastSlotAdjustment
+{
+    uint8_t slotIndex;
+    uint32_t duration;
+    bool hasNominalPower;
+    int64_t nominalPower;
+};
+
+struct ForecastAdjustment
+{
+    uint32_t forecastId = 0;
+    ForecastReason reason = ForecastReason::kLocalOptimization;
+    uint8_t count = 0;
+    ForecastSlotAdjustment slots[kMaxPublishedSlots] = {};
+};
+
+// Fills in the slots and timings of the forecast for a program starting at startTime (seconds since the epoch).
+//
+void BuildForecast(const WashProgram &program, uint32_t startTime, ForecastPlan &plan);
+
+// Moves the forecast to a new start time, keeping its duration.
+//
+void SetForecastStartTime(ForecastPlan &plan, uint32_t startTime);
+
+// Allows an energy manager to move the start anywhere within the window.
+//
+void SetForecastTimeWindow(ForecastPlan &plan, uint32_t earliestStartTime, uint32_t latestEndTime);
+
+void ResetForecast(ForecastPlan &plan);
+
+// Checks every adjustment names a slot in the plan and stays within that slot's
+// duration and power limits.
+//
+bool IsValidForecastAdjustment(const ForecastPlan &plan, const ForecastAdjustment &adjustment);
+
+// Applies the adjustments and moves the end time to match. The forecast ID is
+// left for the caller to change.
+//
+void ApplyForecastAdjustment(ForecastPlan &plan, const ForecastAdjustment &adjustment);
+
+uint32_t GetForecastDuration(const ForecastPlan &plan);
+
+// How many slots the plan's slot is published as, and the published slot for
+// one part of it. Durations are split, and the elapsed and remaining times
+// shared out, in slotResolution pieces; the powers are the slot's own.
+//
+uint8_t GetForecastSlotParts(const ForecastPlan &plan, uint8_t slotIndex);
+ForecastPlanSlot GetForecastSlotPart(const ForecastPlan &plan, uint8_t slotIndex, uint8_t part);
+
+uint8_t GetPublishedSlotCount(const ForecastPlan &plan);
+
+// The published slot that is elapsed seconds into the plan's slot.
+//
+uint8_t GetPublishedSlotIndex(const ForecastPlan &plan, uint8_t slotIndex, uint32_t elapsed);
+uint8_t GetPublishedActiveSlot(const ForecastPlan &plan);
+
+// An estimate of the bytes the Forecast attribute takes as TLV once published.
+// It errs on the large side.
+//
+size_t EstimateForecastSize(const ForecastPlan &plan);
+
+// Sets the finest slotResolution (down to five minutes) at which the published
+// forecast stays within budget bytes and kMaxPublishedSlots.
+//
+void ChooseForecastResolution(ForecastPlan &plan, size_t budget);
+
+// True if the adjustment names any slot more than once.
+//
+bool HasRepeatedForecastSlot(const ForecastAdjustment &adjustment);
+
+// Turns a ModifyForecastRequest on the published slots into one on the plan's
+// slots. Each slot gets the total duration of its parts and the power that
+// delivers their total energy. Returns false if a published slot doesn't exist
+// or is named more than once.
+//
+bool CollapseForecastAdjustment(const ForecastPlan &plan, const ForecastAdjustment &published, ForecastAdjustment &adjustment);
+
+// A PowerAdjustRequest: keep the heater at or below power (mW) for the next
+// duration seconds.
+//
+struct PowerCap
+{
+    int64_t power = 0;
+    uint32_t duration = 0;
+    ForecastReason cause = ForecastReason::kLocalOptimization;
+};
+
+// What a PowerAdjustRequest may currently ask for, and whether one is in force.
+// It is only available while a program is running, and the power range is
+// that of the step being run.
+//
+struct PowerAdjustPlan
+{
+    bool isAvailable = false;
+    int64_t minPower = 0;
+    int64_t maxPower = 0;
+    uint32_t minDuration = 0;
+    uint32_t maxDuration = 0;
+
+    bool isActive = false;
+    ForecastReason cause = ForecastReason::kLocalOptimization;
+};
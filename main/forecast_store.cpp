@@ -0,0 +1,22 @@
+#include "forecast_store.h"
+
+ForecastStore::Buffer &ForecastStore::GetBackBuffer()
+{
+    return mBuffers[1 - mFront.load(std::memory_order_relaxed)];
+}
+
+void ForecastStore::Swap()
+{
+    mFront.store(1 - mFront.load(std::memory_order_relaxed), std::memory_order_release);
+    mSwapCount++;
+}
+
+chip::app::DataModel::Nullable<ForecastStore::ForecastStruct> &ForecastStore::GetForecast()
+{
+    return mBuffers[mFront.load(std::memory_order_acquire)].forecast;
+}
+
+uint32_t ForecastStore::GetSwapCount() const
+{
+    return mSwapCount;
+}
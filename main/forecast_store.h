@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <app-common/zap-generated/cluster-objects.h>
+
+#include <atomic>
+
+#include "forecast_builder.h"
+
+// Holds the DeviceEnergyManagement Forecast attribute in two buffers.
+//
+// The published forecast's slot list points into its buffer, so the buffer
+// can't be written while the attribute might be encoded from it. Each new
+// forecast is built into the other buffer and swapped in whole, leaving the
+// published one untouched until the swap after next. Nothing is copied.
+//
+// Only the Matter thread builds and publishes forecasts.
+//
+class ForecastStore
+{
+public:
+    using ForecastStruct = chip::app::Clusters::DeviceEnergyManagement::Structs::ForecastStruct::Type;
+    using SlotStruct = chip::app::Clusters::DeviceEnergyManagement::Structs::SlotStruct::Type;
+
+    struct Buffer
+    {
+        chip::app::DataModel::Nullable<ForecastStruct> forecast;
+        SlotStruct slots[kMaxPublishedSlots];
+    };
+
+    // The buffer that isn't published, to build the next forecast in.
+    //
+    Buffer &GetBackBuffer();
+
+    // Makes the back buffer the published forecast.
+    //
+    void Swap();
+
+    chip::app::DataModel::Nullable<ForecastStruct> &GetForecast();
+
+    uint32_t GetSwapCount() const;
+
+    // Bytes of RAM the store takes, both buffers included.
+    //
+    static constexpr size_t GetFootprint()
+    {
+        return sizeof(ForecastStore);
+    }
+
+private:
+    Buffer mBuffers[2];
+    std::atomic<uint8_t> mFront{0};
+    uint32_t mSwapCount = 0;
+};
@@ -1,130 +1,222 @@
+#define DISHWASHER_LOG_LEVEL CONFIG_DISHWASHER_LOG_LEVEL_INPUT
+#include "dishwasher_log.h"
+
 #include "mode_selector.h"
 #include <esp_err.h>
-#include <esp_log.h>
+#include <esp_attr.h>
 #include <string.h>
 
-#include <driver/pulse_cnt.h>
 #include <driver/gpio.h>
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <freertos/queue.h>
 
-#include "dishwasher_manager.h"
+#include "dishwasher_events.h"
+#include "telemetry.h"
+
+#define ENCODER_PIN_A GPIO_NUM_18
+#define ENCODER_PIN_B GPIO_NUM_20
 
-#define EXAMPLE_PCNT_HIGH_LIMIT 100
-#define EXAMPLE_PCNT_LOW_LIMIT -100
+#define ENCODER_EVENT_QUEUE_LENGTH 16
+#define ENCODER_TASK_STACK_SIZE 2048
 
 static const char *TAG = "mode_selector";
 
-static pcnt_unit_handle_t pcnt_unit = NULL;
-static QueueHandle_t gpio_pulse_evt_queue = NULL;
+ModeSelector ModeSelector::sModeSelector;
+
+// The encoder is decoded in the GPIO interrupt, from every edge on either pin.
+// Each detent becomes one event on the queue, so a fast spin is never collapsed
+// and the task only wakes when the knob actually moves.
+//
+struct EncoderEvent
+{
+    int8_t direction; // -1 or 1, one detent.
+};
+
+static QueueHandle_t encoder_event_queue = NULL;
+
+// Indexed by the previous and current pin states, (A << 1 | B) each. Valid
+// quadrature transitions move one quarter step, anything else (bounce, or a
+// missed edge) counts as nothing.
+//
+static const int8_t kQuadratureSteps[16] = {
+    0, -1, 1, 0,
+    1, 0, 0, -1,
+    -1, 0, 0, 1,
+    0, 1, -1, 0};
+
+// Detented encoders rest with both pins high.
+//
+static const uint8_t kRestState = 0b11;
+
+static volatile uint8_t encoder_state = 0;
+static volatile int8_t encoder_quarter_steps = 0;
+static volatile uint32_t encoder_dropped_events = 0;
+
+static void IRAM_ATTR encoder_isr_handler(void *arg)
+{
+    uint8_t state = (gpio_get_level(ENCODER_PIN_A) << 1) | gpio_get_level(ENCODER_PIN_B);
 
-static int current_pulse_count = 0;
-static int pulse_count = 0;
-static int event_count = 0;
+    int8_t quarter_steps = encoder_quarter_steps + kQuadratureSteps[(encoder_state << 2) | state];
+    int8_t direction = 0;
 
-ModeSelector ModeSelector::sModeSelector;
+    encoder_state = state;
+
+    if (quarter_steps >= CONFIG_DISHWASHER_ENCODER_STEPS_PER_DETENT)
+    {
+        direction = 1;
+        quarter_steps -= CONFIG_DISHWASHER_ENCODER_STEPS_PER_DETENT;
+    }
+    else if (quarter_steps <= -CONFIG_DISHWASHER_ENCODER_STEPS_PER_DETENT)
+    {
+        direction = -1;
+        quarter_steps += CONFIG_DISHWASHER_ENCODER_STEPS_PER_DETENT;
+    }
+
+    // Arriving at a detent part way through a step means an edge was missed,
+    // so round to the nearest detent and start again from there.
+    //
+    if (state == kRestState)
+    {
+        if (direction == 0 && quarter_steps * 2 >= CONFIG_DISHWASHER_ENCODER_STEPS_PER_DETENT)
+        {
+            direction = 1;
+        }
+        else if (direction == 0 && quarter_steps * 2 <= -CONFIG_DISHWASHER_ENCODER_STEPS_PER_DETENT)
+        {
+            direction = -1;
+        }
+
+        quarter_steps = 0;
+    }
+
+    encoder_quarter_steps = quarter_steps;
+
+    if (direction == 0)
+    {
+        return;
+    }
 
-#define EXAMPLE_PCNT_HIGH_LIMIT 100
-#define EXAMPLE_PCNT_LOW_LIMIT -100
+    EncoderEvent event = {
+        .direction = direction,
+    };
+
+    BaseType_t higher_priority_task_woken = pdFALSE;
+
+    if (xQueueSendFromISR(encoder_event_queue, &event, &higher_priority_task_woken) != pdTRUE)
+    {
+        encoder_dropped_events = encoder_dropped_events + 1;
+    }
 
-static void pulse_counter_monitor_task(void *arg)
+    if (higher_priority_task_woken)
+    {
+        portYIELD_FROM_ISR();
+    }
+}
+
+// Each detent is one step. The encoder only toggles the energy management
+// option, so detents are never accelerated into several steps, which could
+// cancel each other out.
+//
+static void encoder_event_task(void *arg)
 {
     while (1)
     {
-        // ESP_LOGI(TAG, "Waiting for event on pulse_evt_queue");
+        EncoderEvent event;
+
+        // Blocks until the knob is turned.
+        //
+        if (xQueueReceive(encoder_event_queue, &event, portMAX_DELAY) != pdTRUE)
+        {
+            continue;
+        }
 
-        if (xQueueReceive(gpio_pulse_evt_queue, &event_count, pdMS_TO_TICKS(500)))
+        ESP_LOGD(TAG, "Encoder detent %d", event.direction);
+
+        // Counting down selects the next item, as it did with the pulse counter.
+        //
+        if (event.direction < 0)
         {
-            ESP_LOGI(TAG, "Watch point event, count: %d", event_count);
+            DishwasherPostEvent(DishwasherEventType::kEncoderNext);
         }
         else
         {
-            ESP_ERROR_CHECK(pcnt_unit_get_count(pcnt_unit, &pulse_count));
-            // ESP_LOGI(TAG, "Current pulse count: %d", pulse_count);
-
-            if (pulse_count != current_pulse_count)
-            {
-                int pulse_difference = pulse_count - current_pulse_count;
-
-                current_pulse_count = pulse_count;
-
-                // ESP_LOGI(TAG, "Pulse Difference: %d", pulse_difference);
-
-                if (pulse_difference < 0)
-                {
-                    DishwasherMgr().SelectNext();//.SelectNextMode();
-                }
-                else
-                {
-                    DishwasherMgr().SelectPrevious();//.SelectPreviousMode();
-                }
-            }
+            DishwasherPostEvent(DishwasherEventType::kEncoderPrevious);
         }
     }
 }
 
 esp_err_t ModeSelector::Init()
 {
-    ESP_LOGI(TAG, "install pcnt unit");
-
-    pcnt_unit_config_t unit_config = {
-        .low_limit = EXAMPLE_PCNT_LOW_LIMIT,
-        .high_limit = EXAMPLE_PCNT_HIGH_LIMIT,
-        .intr_priority = 1};
-
-    ESP_ERROR_CHECK(pcnt_new_unit(&unit_config, &pcnt_unit));
-
-    ESP_LOGI(TAG, "set glitch filter");
-    pcnt_glitch_filter_config_t filter_config = {
-        .max_glitch_ns = 1000,
+    ESP_LOGI(TAG, "configure encoder pins");
+
+    gpio_config_t encoder_config = {
+        .pin_bit_mask = (1ULL << ENCODER_PIN_A) | (1ULL << ENCODER_PIN_B),
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_ANYEDGE,
     };
-    ESP_ERROR_CHECK(pcnt_unit_set_glitch_filter(pcnt_unit, &filter_config));
+    ESP_ERROR_CHECK(gpio_config(&encoder_config));
 
-    ESP_LOGI(TAG, "install pcnt channels");
-    pcnt_chan_config_t chan_a_config = {
-        .edge_gpio_num = GPIO_NUM_18,
-        .level_gpio_num = GPIO_NUM_20,
-    };
-    pcnt_channel_handle_t pcnt_chan_a = NULL;
-    ESP_ERROR_CHECK(pcnt_new_channel(pcnt_unit, &chan_a_config, &pcnt_chan_a));
-    pcnt_chan_config_t chan_b_config = {
-        .edge_gpio_num = GPIO_NUM_20,
-        .level_gpio_num = GPIO_NUM_18,
-    };
-    pcnt_channel_handle_t pcnt_chan_b = NULL;
-    ESP_ERROR_CHECK(pcnt_new_channel(pcnt_unit, &chan_b_config, &pcnt_chan_b));
-
-    ESP_LOGI(TAG, "set edge and level actions for pcnt channels");
-    ESP_ERROR_CHECK(pcnt_channel_set_edge_action(pcnt_chan_a, PCNT_CHANNEL_EDGE_ACTION_DECREASE, PCNT_CHANNEL_EDGE_ACTION_INCREASE));
-    ESP_ERROR_CHECK(pcnt_channel_set_level_action(pcnt_chan_a, PCNT_CHANNEL_LEVEL_ACTION_KEEP, PCNT_CHANNEL_LEVEL_ACTION_INVERSE));
-    ESP_ERROR_CHECK(pcnt_channel_set_edge_action(pcnt_chan_b, PCNT_CHANNEL_EDGE_ACTION_INCREASE, PCNT_CHANNEL_EDGE_ACTION_DECREASE));
-    ESP_ERROR_CHECK(pcnt_channel_set_level_action(pcnt_chan_b, PCNT_CHANNEL_LEVEL_ACTION_KEEP, PCNT_CHANNEL_LEVEL_ACTION_INVERSE));
-
-    ESP_LOGI(TAG, "add watch points and register callbacks");
-    int watch_points[] = {EXAMPLE_PCNT_LOW_LIMIT, -50, 0, 50, EXAMPLE_PCNT_HIGH_LIMIT};
-    for (size_t i = 0; i < sizeof(watch_points) / sizeof(watch_points[0]); i++)
+    encoder_event_queue = xQueueCreate(ENCODER_EVENT_QUEUE_LENGTH, sizeof(EncoderEvent));
+
+    // The button component shares the ISR service, so it may already be installed.
+    //
+    esp_err_t err = gpio_install_isr_service(0);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE)
     {
-        ESP_ERROR_CHECK(pcnt_unit_add_watch_point(pcnt_unit, watch_points[i]));
+        return err;
     }
-    pcnt_event_callbacks_t cbs = {
-        .on_reach = NULL,
-    };
 
-    gpio_pulse_evt_queue = xQueueCreate(10, sizeof(int));
-    ESP_ERROR_CHECK(pcnt_unit_register_event_callbacks(pcnt_unit, &cbs, gpio_pulse_evt_queue));
+    encoder_state = (gpio_get_level(ENCODER_PIN_A) << 1) | gpio_get_level(ENCODER_PIN_B);
 
-    ESP_LOGI(TAG, "enable pcnt unit");
-    ESP_ERROR_CHECK(pcnt_unit_enable(pcnt_unit));
-    ESP_LOGI(TAG, "clear pcnt unit");
-    ESP_ERROR_CHECK(pcnt_unit_clear_count(pcnt_unit));
-    ESP_LOGI(TAG, "start pcnt unit");
-    ESP_ERROR_CHECK(pcnt_unit_start(pcnt_unit));
+    ESP_ERROR_CHECK(gpio_isr_handler_add(ENCODER_PIN_A, encoder_isr_handler, NULL));
+    ESP_ERROR_CHECK(gpio_isr_handler_add(ENCODER_PIN_B, encoder_isr_handler, NULL));
 
-    xTaskCreate(pulse_counter_monitor_task, "mode_selector_task", 2048, NULL, tskIDLE_PRIORITY, NULL);
+    xTaskCreate(encoder_event_task, "mode_selector_task", ENCODER_TASK_STACK_SIZE, NULL, tskIDLE_PRIORITY + 1, NULL);
+    TelemetryMgr().WatchTask("mode_selector_task", ENCODER_TASK_STACK_SIZE);
+
+    mIsSuspended = false;
 
     ESP_LOGI(TAG, "mode_selector initialised");
 
     return ESP_OK;
-}
\ No newline at end of file
+}
+
+void ModeSelector::Suspend()
+{
+    if (mIsSuspended)
+    {
+        return;
+    }
+
+    ESP_LOGD(TAG, "Suspending mode selector, %lu event(s) dropped so far", encoder_dropped_events);
+
+    mIsSuspended = true;
+
+    gpio_intr_disable(ENCODER_PIN_A);
+    gpio_intr_disable(ENCODER_PIN_B);
+}
+
+void ModeSelector::Resume()
+{
+    if (!mIsSuspended)
+    {
+        return;
+    }
+
+    ESP_LOGD(TAG, "Resuming mode selector");
+
+    // Turns made while suspended are ignored.
+    //
+    xQueueReset(encoder_event_queue);
+    encoder_state = (gpio_get_level(ENCODER_PIN_A) << 1) | gpio_get_level(ENCODER_PIN_B);
+    encoder_quarter_steps = 0;
+
+    mIsSuspended = false;
+
+    gpio_intr_enable(ENCODER_PIN_A);
+    gpio_intr_enable(ENCODER_PIN_B);
+}
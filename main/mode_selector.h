@@ -6,9 +6,17 @@ class ModeSelector
 public:
     esp_err_t Init();
 
+    // Stops and restarts the encoder interrupts, so the encoder is ignored
+    // while the display is asleep.
+    //
+    void Suspend();
+    void Resume();
+
 private:
     friend ModeSelector & ModeSelectorMgr(void);
     static ModeSelector sModeSelector;
+
+    bool mIsSuspended = true;
 };
 
 inline ModeSelector & ModeSelectorMgr(void)
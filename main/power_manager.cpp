@@ -0,0 +1,137 @@
+#define DISHWASHER_LOG_LEVEL CONFIG_DISHWASHER_LOG_LEVEL_PROGRAM
+#include "dishwasher_log.h"
+
+#include "power_manager.h"
+
+#include <esp_timer.h>
+
+static const char *TAG = "power_manager";
+
+PowerManager PowerManager::sPowerManager;
+
+static uint64_t NowMs()
+{
+    return esp_timer_get_time() / 1000;
+}
+
+esp_err_t PowerManager::Init()
+{
+    ESP_LOGI(TAG, "Initializing PowerManager");
+
+    mState = PowerState::kActive;
+    mStateEnteredAt = NowMs();
+
+#if CONFIG_DISHWASHER_POWER_MANAGEMENT
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = CONFIG_XTAL_FREQ,
+        .light_sleep_enable = true,
+    };
+    ESP_ERROR_CHECK(esp_pm_configure(&pm_config));
+
+    ESP_ERROR_CHECK(esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "dishwasher", &mNoLightSleepLock));
+    ESP_ERROR_CHECK(esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "dishwasher", &mCpuFreqMaxLock));
+
+    // Boot starts out active, until DishwasherManager says otherwise.
+    //
+    esp_pm_lock_acquire(mNoLightSleepLock);
+    esp_pm_lock_acquire(mCpuFreqMaxLock);
+#else
+    ESP_LOGI(TAG, "Light sleep is disabled, power states are tracked only");
+#endif
+
+    return ESP_OK;
+}
+
+void PowerManager::Update(bool is_display_active, bool is_program_running)
+{
+    PowerState state = PowerState::kLightSleep;
+
+    if (is_display_active)
+    {
+        state = PowerState::kActive;
+    }
+    else if (is_program_running)
+    {
+        state = PowerState::kAwake;
+    }
+
+    if (state != mState)
+    {
+        EnterState(state);
+    }
+}
+
+void PowerManager::EnterState(PowerState state)
+{
+    uint64_t now = NowMs();
+
+    mTimeInState[(uint8_t)mState] += now - mStateEnteredAt;
+    mStateEnteredAt = now;
+
+    ESP_LOGD(TAG, "Power state %s -> %s", GetStateName(mState), GetStateName(state));
+
+    // Locks are counted, so each one is only taken on the way up and given back on the way down.
+    //
+    bool held_no_light_sleep = mState != PowerState::kLightSleep;
+    bool needs_no_light_sleep = state != PowerState::kLightSleep;
+    bool held_cpu_freq_max = mState == PowerState::kActive;
+    bool needs_cpu_freq_max = state == PowerState::kActive;
+
+    mState = state;
+
+    if (mNoLightSleepLock == nullptr)
+    {
+        return;
+    }
+
+    if (needs_no_light_sleep && !held_no_light_sleep)
+    {
+        esp_pm_lock_acquire(mNoLightSleepLock);
+    }
+    else if (!needs_no_light_sleep && held_no_light_sleep)
+    {
+        esp_pm_lock_release(mNoLightSleepLock);
+    }
+
+    if (needs_cpu_freq_max && !held_cpu_freq_max)
+    {
+        esp_pm_lock_acquire(mCpuFreqMaxLock);
+    }
+    else if (!needs_cpu_freq_max && held_cpu_freq_max)
+    {
+        esp_pm_lock_release(mCpuFreqMaxLock);
+    }
+}
+
+PowerState PowerManager::GetState()
+{
+    return mState;
+}
+
+uint64_t PowerManager::GetTimeInState(PowerState state)
+{
+    uint64_t time = mTimeInState[(uint8_t)state];
+
+    if (state == mState)
+    {
+        time += NowMs() - mStateEnteredAt;
+    }
+
+    return time;
+}
+
+const char *PowerManager::GetStateName(PowerState state)
+{
+    switch (state)
+    {
+    case PowerState::kLightSleep:
+        return "light sleep";
+    case PowerState::kAwake:
+        return "awake";
+    case PowerState::kActive:
+        return "active";
+    default:
+        return "";
+    }
+}
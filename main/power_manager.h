@@ -0,0 +1,62 @@
+#pragma once
+
+#include <esp_err.h>
+#include <esp_pm.h>
+
+#include <inttypes.h>
+
+// What the chip is allowed to do, from the locks PowerManager holds.
+//
+//   kLightSleep  No locks. The chip runs at the minimum clock and sleeps between
+//                timer and button wakeups, e.g. while waiting for a delayed start.
+//   kAwake       Light sleep is blocked, but the clock may still be scaled down.
+//                Held while a program is running with the display asleep.
+//   kActive      Light sleep is blocked and the CPU runs at full speed, so LVGL
+//                redraws quickly. Held while the display is on.
+//
+enum class PowerState : uint8_t
+{
+    kLightSleep,
+    kAwake,
+    kActive,
+};
+
+constexpr uint8_t kPowerStateCount = 3;
+
+class PowerManager
+{
+public:
+    esp_err_t Init();
+
+    // Picks the power state for what the device is doing and takes or releases
+    // the locks for it.
+    //
+    void Update(bool is_display_active, bool is_program_running);
+
+    PowerState GetState();
+
+    // Milliseconds spent in a state since boot, including the current visit.
+    //
+    uint64_t GetTimeInState(PowerState state);
+
+    static const char *GetStateName(PowerState state);
+
+private:
+    friend PowerManager &PowerMgr(void);
+
+    static PowerManager sPowerManager;
+
+    void EnterState(PowerState state);
+
+    esp_pm_lock_handle_t mNoLightSleepLock = nullptr;
+    esp_pm_lock_handle_t mCpuFreqMaxLock = nullptr;
+
+    PowerState mState = PowerState::kActive;
+    uint64_t mStateEnteredAt = 0;
+    uint64_t mTimeInState[kPowerStateCount] = {};
+};
+
+inline PowerManager &PowerMgr(void)
+{
+    return PowerManager::sPowerManager;
+}
@@ -0,0 +1,309 @@
+#include "program_engine.h"
+
+static uint32_t CeilSeconds(uint64_t ms)
+{
+    return (uint32_t)((ms + 999) / 1000);
+}
+
+void ProgramEngine::Start(uint64_t nowMs, uint32_t delaySeconds, const uint32_t *stepDurations, uint8_t stepCount, uint32_t elapsedSeconds)
+{
+    if (stepCount > kMaxSteps)
+    {
+        stepCount = kMaxSteps;
+    }
+
+    uint64_t end = 0;
+
+    for (uint8_t i = 0; i < stepCount; i++)
+    {
+        end += (uint64_t)stepDurations[i] * 1000;
+        mStepEndsMs[i] = end;
+    }
+
+    mStepCount = stepCount;
+    mRunStartMs = nowMs + (uint64_t)delaySeconds * 1000;
+    mPausedAtMs = 0;
+    mPausedTotalMs = 0;
+    mElapsedAtStartMs = (uint64_t)elapsedSeconds * 1000;
+    mIsPaused = false;
+    mIsActive = true;
+}
+
+void ProgramEngine::Stop()
+{
+    mIsActive = false;
+    mIsPaused = false;
+    mStepCount = 0;
+}
+
+void ProgramEngine::Pause(uint64_t nowMs)
+{
+    if (GetStage(nowMs) != Stage::kRunning)
+    {
+        return;
+    }
+
+    mIsPaused = true;
+    mPausedAtMs = nowMs;
+}
+
+void ProgramEngine::Resume(uint64_t nowMs)
+{
+    if (!mIsActive || !mIsPaused)
+    {
+        return;
+    }
+
+    mPausedTotalMs += nowMs - mPausedAtMs;
+    mIsPaused = false;
+}
+
+void ProgramEngine::SetStartDelay(uint64_t nowMs, uint32_t delaySeconds)
+{
+    // Once the program is running, the start time is history.
+    //
+    if (GetStage(nowMs) != Stage::kDelayedStart)
+    {
+        return;
+    }
+
+    mRunStartMs = nowMs + (uint64_t)delaySeconds * 1000;
+}
+
+bool ProgramEngine::SetStepDurations(uint64_t nowMs, const uint32_t *stepDurations, uint8_t stepCount)
+{
+    if (!mIsActive || stepCount != mStepCount)
+    {
+        return false;
+    }
+
+    uint64_t elapsed = GetElapsedMs(nowMs);
+    uint64_t ends[kMaxSteps];
+    uint64_t end = 0;
+
+    for (uint8_t i = 0; i < stepCount; i++)
+    {
+        end += (uint64_t)stepDurations[i] * 1000;
+        ends[i] = end;
+
+        bool has_finished = mStepEndsMs[i] <= elapsed;
+
+        if (has_finished ? ends[i] != mStepEndsMs[i] : ends[i] <= elapsed)
+        {
+            return false;
+        }
+    }
+
+    for (uint8_t i = 0; i < stepCount; i++)
+    {
+        mStepEndsMs[i] = ends[i];
+    }
+
+    return true;
+}
+
+bool ProgramEngine::SetStepRemaining(uint64_t nowMs, uint64_t remainingMs)
+{
+    if (GetStage(nowMs) != Stage::kRunning)
+    {
+        return false;
+    }
+
+    uint8_t step = GetStep(nowMs);
+    uint64_t end = GetElapsedMs(nowMs) + remainingMs;
+    uint64_t step_start = step > 0 ? mStepEndsMs[step - 1] : 0;
+
+    // Always leave the step a little time, so it still ends on a deadline.
+    //
+    if (end <= step_start)
+    {
+        end = step_start + 1;
+    }
+
+    int64_t shift = (int64_t)end - (int64_t)mStepEndsMs[step];
+
+    for (uint8_t i = step; i < mStepCount; i++)
+    {
+        mStepEndsMs[i] += shift;
+    }
+
+    return true;
+}
+
+void ProgramEngine::Skip(uint64_t nowMs, uint32_t seconds)
+{
+    if (!mIsActive || mIsPaused)
+    {
+        return;
+    }
+
+    uint64_t skip_ms = (uint64_t)seconds * 1000;
+
+    if (nowMs < mRunStartMs)
+    {
+        uint64_t delay_ms = mRunStartMs - nowMs;
+
+        if (skip_ms < delay_ms)
+        {
+            mRunStartMs -= skip_ms;
+            return;
+        }
+
+        skip_ms -= delay_ms;
+        mRunStartMs = nowMs;
+    }
+
+    mElapsedAtStartMs += skip_ms;
+}
+
+ProgramEngine::Stage ProgramEngine::GetStage(uint64_t nowMs) const
+{
+    if (!mIsActive)
+    {
+        return Stage::kIdle;
+    }
+
+    if (mIsPaused)
+    {
+        return Stage::kPaused;
+    }
+
+    if (nowMs < mRunStartMs)
+    {
+        return Stage::kDelayedStart;
+    }
+
+    if (GetElapsedMs(nowMs) >= GetTotalMs())
+    {
+        return Stage::kFinished;
+    }
+
+    return Stage::kRunning;
+}
+
+uint8_t ProgramEngine::GetStep(uint64_t nowMs) const
+{
+    uint64_t elapsed = GetElapsedMs(nowMs);
+
+    for (uint8_t i = 0; i < mStepCount; i++)
+    {
+        if (elapsed < mStepEndsMs[i])
+        {
+            return i;
+        }
+    }
+
+    return mStepCount > 0 ? mStepCount - 1 : 0;
+}
+
+uint32_t ProgramEngine::GetStartsIn(uint64_t nowMs) const
+{
+    if (!mIsActive || nowMs >= mRunStartMs)
+    {
+        return 0;
+    }
+
+    return CeilSeconds(mRunStartMs - nowMs);
+}
+
+uint32_t ProgramEngine::GetTimeRemaining(uint64_t nowMs) const
+{
+    if (!mIsActive)
+    {
+        return 0;
+    }
+
+    uint64_t total = GetTotalMs();
+    uint64_t elapsed = GetElapsedMs(nowMs);
+
+    return elapsed >= total ? 0 : CeilSeconds(total - elapsed);
+}
+
+// Steps stretched or shortened by SetStepRemaining can end part way through a
+// second, so round up rather than report the program ending early.
+//
+uint32_t ProgramEngine::GetTotalDuration() const
+{
+    return CeilSeconds(GetTotalMs());
+}
+
+uint64_t ProgramEngine::GetTotalMs() const
+{
+    return mStepCount > 0 ? mStepEndsMs[mStepCount - 1] : 0;
+}
+
+uint32_t ProgramEngine::GetElapsed(uint64_t nowMs) const
+{
+    return (uint32_t)(GetElapsedMs(nowMs) / 1000);
+}
+
+uint64_t ProgramEngine::GetStepRemainingMs(uint64_t nowMs) const
+{
+    if (!mIsActive || mStepCount == 0)
+    {
+        return 0;
+    }
+
+    uint64_t elapsed = GetElapsedMs(nowMs);
+    uint64_t end = mStepEndsMs[GetStep(nowMs)];
+
+    return end > elapsed ? end - elapsed : 0;
+}
+
+uint32_t ProgramEngine::GetStepDuration(uint8_t step) const
+{
+    if (step >= mStepCount)
+    {
+        return 0;
+    }
+
+    uint64_t start = step > 0 ? mStepEndsMs[step - 1] : 0;
+
+    return CeilSeconds(mStepEndsMs[step] - start);
+}
+
+uint64_t ProgramEngine::GetNextDeadline(uint64_t nowMs) const
+{
+    switch (GetStage(nowMs))
+    {
+    case Stage::kDelayedStart:
+        return mRunStartMs;
+
+    case Stage::kRunning:
+    {
+        // The next step boundary, or the end of the program.
+        //
+        uint64_t elapsed = GetElapsedMs(nowMs);
+
+        for (uint8_t i = 0; i < mStepCount; i++)
+        {
+            if (elapsed < mStepEndsMs[i])
+            {
+                return nowMs + (mStepEndsMs[i] - elapsed);
+            }
+        }
+
+        return nowMs;
+    }
+
+    case Stage::kFinished:
+        return nowMs;
+
+    default:
+        // Idle and paused programs have nothing to wait for.
+        //
+        return kNoDeadline;
+    }
+}
+
+uint64_t ProgramEngine::GetElapsedMs(uint64_t nowMs) const
+{
+    uint64_t until = mIsPaused ? mPausedAtMs : nowMs;
+
+    if (!mIsActive || until < mRunStartMs)
+    {
+        return 0;
+    }
+
+    return until - mRunStartMs - mPausedTotalMs + mElapsedAtStartMs;
+}
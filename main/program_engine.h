@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdint.h>
+
+// Tracks a wash program against a monotonic millisecond clock.
+//
+// Nothing in here ticks. Callers ask for the state at "now" and for the next
+// deadline at which that state will change, then arm a one-shot timer for it.
+// Remaining time is always derived from the start timestamp, so it stays
+// accurate no matter how late a timer fires.
+//
+class ProgramEngine
+{
+public:
+    static constexpr uint8_t kMaxSteps = 8;
+    static constexpr uint64_t kNoDeadline = UINT64_MAX;
+
+    enum class Stage : uint8_t
+    {
+        kIdle,
+        kDelayedStart,
+        kRunning,
+        kPaused,
+        kFinished
+    };
+
+    // elapsedSeconds starts the program part way through, for resuming one that
+    // was interrupted. It only applies once any delayed start is over.
+    //
+    void Start(uint64_t nowMs, uint32_t delaySeconds, const uint32_t *stepDurations, uint8_t stepCount, uint32_t elapsedSeconds = 0);
+    void Stop();
+    void Pause(uint64_t nowMs);
+    void Resume(uint64_t nowMs);
+    void SetStartDelay(uint64_t nowMs, uint32_t delaySeconds);
+
+    // Changes how long each step lasts. Steps that have already finished can't
+    // change, and the current step can't be made to end before now. Returns
+    // false, changing nothing, if they would.
+    //
+    bool SetStepDurations(uint64_t nowMs, const uint32_t *stepDurations, uint8_t stepCount);
+
+    // Makes the current step end remainingMs from now, moving the steps after
+    // it by the same amount. Only while running.
+    //
+    bool SetStepRemaining(uint64_t nowMs, uint64_t remainingMs);
+
+    // Moves the program on by seconds that passed without it, first through
+    // any delayed start and then through the steps. Not while paused.
+    //
+    void Skip(uint64_t nowMs, uint32_t seconds);
+
+    Stage GetStage(uint64_t nowMs) const;
+    uint8_t GetStep(uint64_t nowMs) const;
+
+    uint32_t GetStartsIn(uint64_t nowMs) const;
+    uint32_t GetTimeRemaining(uint64_t nowMs) const;
+    uint32_t GetTotalDuration() const;
+    uint32_t GetElapsed(uint64_t nowMs) const;
+    uint64_t GetStepRemainingMs(uint64_t nowMs) const;
+    uint32_t GetStepDuration(uint8_t step) const;
+
+    uint64_t GetNextDeadline(uint64_t nowMs) const;
+
+private:
+    uint64_t GetElapsedMs(uint64_t nowMs) const;
+    uint64_t GetTotalMs() const;
+
+    bool mIsActive = false;
+    bool mIsPaused = false;
+
+    uint64_t mRunStartMs = 0;
+    uint64_t mPausedAtMs = 0;
+    uint64_t mPausedTotalMs = 0;
+    uint64_t mElapsedAtStartMs = 0;
+
+    // Cumulative end of each step, in milliseconds from the start of the run.
+    //
+    uint64_t mStepEndsMs[kMaxSteps] = {};
+    uint8_t mStepCount = 0;
+};
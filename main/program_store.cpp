@@ -0,0 +1,109 @@
+#define DISHWASHER_LOG_LEVEL CONFIG_DISHWASHER_LOG_LEVEL_PROGRAM
+#include "dishwasher_log.h"
+
+#include "program_store.h"
+
+#include <string.h>
+
+static const char *TAG = "program_store";
+
+static const char *kNamespace = "dishwasher";
+
+esp_err_t ProgramStore::Open()
+{
+    if (mIsOpen)
+    {
+        return ESP_OK;
+    }
+
+    esp_err_t err = nvs_open(kNamespace, NVS_READWRITE, &mHandle);
+
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to open NVS namespace %s, err:%d", kNamespace, err);
+        return err;
+    }
+
+    mIsOpen = true;
+
+    return ESP_OK;
+}
+
+esp_err_t ProgramStore::Load(ProgramCheckpoint &checkpoint)
+{
+    esp_err_t err = Open();
+
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+
+    size_t length = sizeof(checkpoint);
+    err = nvs_get_blob(mHandle, mKey, &checkpoint, &length);
+
+    if (err == ESP_ERR_NVS_NOT_FOUND)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    if (err != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Failed to read the program checkpoint, err:%d", err);
+        return err;
+    }
+
+    if (length != sizeof(checkpoint) || checkpoint.version != kProgramCheckpointVersion)
+    {
+        ESP_LOGW(TAG, "Ignoring a program checkpoint from another firmware version");
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    mLastSaved = checkpoint;
+    mHasSaved = true;
+
+    return ESP_OK;
+}
+
+esp_err_t ProgramStore::Save(const ProgramCheckpoint &checkpoint)
+{
+    ProgramCheckpoint compare = checkpoint;
+    compare.savedAt = mLastSaved.savedAt;
+
+    if (mHasSaved && memcmp(&compare, &mLastSaved, sizeof(compare)) == 0)
+    {
+        return ESP_OK;
+    }
+
+    esp_err_t err = Open();
+
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+
+    err = nvs_set_blob(mHandle, mKey, &checkpoint, sizeof(checkpoint));
+
+    if (err == ESP_OK)
+    {
+        err = nvs_commit(mHandle);
+    }
+
+    if (err != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Failed to write the program checkpoint, err:%d", err);
+        return err;
+    }
+
+    ESP_LOGD(TAG, "Saved checkpoint: state %u, starts in %lu, elapsed %lu", checkpoint.state, checkpoint.startsIn, checkpoint.elapsed);
+
+    mLastSaved = checkpoint;
+    mHasSaved = true;
+    mWriteCount++;
+
+    return ESP_OK;
+}
+
+uint32_t ProgramStore::GetWriteCount() const
+{
+    return mWriteCount;
+}
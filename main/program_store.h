@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <esp_err.h>
+#include <nvs.h>
+
+#include "wash_programs.h"
+
+// Keeps the running program in NVS, so it can be picked up again after a
+// reboot or power cut.
+//
+// The checkpoint is one small blob in the default "nvs" partition. It is only
+// written when the program changes state and every so often while it runs (see
+// DISHWASHER_CHECKPOINT_INTERVAL), so a wash cycle costs a handful of writes,
+// and NVS spreads those across its pages.
+//
+// Times are stored against the wall clock, so on boot the program can be moved
+// on by however long the device was off. If the time isn't known yet, it
+// carries on from the last checkpoint instead.
+//
+constexpr uint8_t kProgramCheckpointVersion = 2;
+
+// Anything before 2024 means the clock hasn't been set.
+//
+constexpr uint32_t kMinValidEpochTime = 1704067200;
+
+struct ProgramCheckpoint
+{
+    uint8_t version;
+    uint8_t state;
+    uint8_t mode;
+    uint8_t optedIn;
+
+    // Seconds since the Unix epoch when this was written, or 0 if unknown.
+    //
+    uint32_t savedAt;
+
+    // Where the program was at savedAt.
+    //
+    uint32_t startsIn;
+    uint32_t elapsed;
+
+    uint32_t forecastId;
+    uint32_t forecastStartTime;
+    uint32_t earliestStartTime;
+    uint32_t latestEndTime;
+    uint8_t hasTimeWindow;
+    uint8_t forecastReason;
+    uint8_t reserved[2];
+
+    // How long each step takes and the power its slot forecasts, which an
+    // energy manager or a power cap may have changed from the program's own.
+    //
+    uint32_t stepDurations[kMaxWashSteps];
+    int64_t slotNominalPowers[kMaxWashSteps];
+};
+
+static_assert(sizeof(ProgramCheckpoint) == 96, "ProgramCheckpoint is stored as is, so changing it needs a new version");
+
+class ProgramStore
+{
+public:
+    // Each dishwasher keeps its checkpoint under its own NVS key, of at most
+    // 15 characters.
+    //
+    explicit ProgramStore(const char *key) : mKey(key) {}
+
+    // Returns ESP_ERR_NOT_FOUND if there is no checkpoint, or it was written by
+    // a different version of the firmware.
+    //
+    esp_err_t Load(ProgramCheckpoint &checkpoint);
+
+    // Skips the write if nothing but savedAt has changed since the last one.
+    //
+    esp_err_t Save(const ProgramCheckpoint &checkpoint);
+
+    uint32_t GetWriteCount() const;
+
+private:
+    esp_err_t Open();
+
+    const char *mKey;
+    nvs_handle_t mHandle = 0;
+    bool mIsOpen = false;
+
+    ProgramCheckpoint mLastSaved = {};
+    bool mHasSaved = false;
+
+    uint32_t mWriteCount = 0;
+};
@@ -0,0 +1,135 @@
+#include "start_scheduler.h"
+
+// The running sum of the curve's cost, in cost x seconds, from the start of the
+// curve to the start of each bucket.
+//
+struct CostSum
+{
+    const TariffCurve &curve;
+    int64_t sums[kMaxTariffBuckets + 1];
+
+    explicit CostSum(const TariffCurve &tariff) : curve(tariff)
+    {
+        sums[0] = 0;
+
+        for (uint8_t i = 0; i < curve.bucketCount; i++)
+        {
+            sums[i + 1] = sums[i] + (int64_t)curve.costs[i] * curve.bucketDuration;
+        }
+    }
+
+    // The total cost from the start of the curve up to time (seconds after it,
+    // which may be negative or past the end).
+    //
+    int64_t Until(int64_t time) const
+    {
+        if (curve.bucketCount == 0 || curve.bucketDuration == 0)
+        {
+            return 0;
+        }
+
+        int64_t end = (int64_t)curve.bucketCount * curve.bucketDuration;
+
+        if (time <= 0)
+        {
+            return time * curve.costs[0];
+        }
+
+        if (time >= end)
+        {
+            return sums[curve.bucketCount] + (time - end) * curve.costs[curve.bucketCount - 1];
+        }
+
+        int64_t bucket = time / curve.bucketDuration;
+
+        return sums[bucket] + (time - bucket * curve.bucketDuration) * curve.costs[bucket];
+    }
+};
+
+static int64_t GetCost(const ForecastPlan &plan, const CostSum &sum, int64_t start)
+{
+    int64_t cost = 0;
+    int64_t slot_start = start;
+
+    for (uint8_t i = 0; i < plan.slotCount; i++)
+    {
+        int64_t slot_end = slot_start + plan.slots[i].defaultDuration;
+
+        cost += plan.slots[i].nominalPower * (sum.Until(slot_end) - sum.Until(slot_start));
+        slot_start = slot_end;
+    }
+
+    return cost;
+}
+
+int64_t GetForecastCost(const ForecastPlan &plan, const TariffCurve &curve, uint32_t startTime)
+{
+    CostSum sum(curve);
+
+    return GetCost(plan, sum, (int64_t)startTime - curve.startTime);
+}
+
+bool FindCheapestStart(const ForecastPlan &plan, const TariffCurve &curve, uint32_t earliestStartTime, uint32_t latestEndTime, uint32_t &startTime)
+{
+    uint32_t duration = GetForecastDuration(plan);
+
+    if (latestEndTime < earliestStartTime || latestEndTime - earliestStartTime < duration)
+    {
+        return false;
+    }
+
+    // Start times are worked on relative to the start of the curve.
+    //
+    int64_t first = (int64_t)earliestStartTime - curve.startTime;
+    int64_t last = (int64_t)latestEndTime - duration - curve.startTime;
+
+    startTime = earliestStartTime;
+
+    if (curve.bucketCount == 0 || curve.bucketDuration == 0)
+    {
+        return true;
+    }
+
+    CostSum sum(curve);
+
+    int64_t best_start = first;
+    int64_t best_cost = GetCost(plan, sum, first);
+
+    auto consider = [&](int64_t start) {
+        if (start <= first || start > last)
+        {
+            return;
+        }
+
+        int64_t cost = GetCost(plan, sum, start);
+
+        if (cost < best_cost || (cost == best_cost && start < best_start))
+        {
+            best_cost = cost;
+            best_start = start;
+        }
+    };
+
+    consider(last);
+
+    // Line each slot boundary up with each bucket boundary in turn.
+    //
+    int64_t offset = 0;
+
+    for (uint8_t i = 0; i <= plan.slotCount; i++)
+    {
+        for (uint8_t bucket = 0; bucket <= curve.bucketCount; bucket++)
+        {
+            consider((int64_t)bucket * curve.bucketDuration - offset);
+        }
+
+        if (i < plan.slotCount)
+        {
+            offset += plan.slots[i].defaultDuration;
+        }
+    }
+
+    startTime = (uint32_t)(best_start + curve.startTime);
+
+    return true;
+}
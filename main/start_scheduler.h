@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "forecast_builder.h"
+
+// Picks the cheapest time to run a program, given what energy will cost.
+//
+// The cost can be anything where lower is better: a tariff, the carbon
+// intensity of the grid, or how much an energy manager would rather we didn't
+// run. It is given for equal buckets of time, and the cost of a start time is
+// the energy of each forecast slot weighted by the cost of the buckets it
+// overlaps.
+//
+
+// Enough for 24 hours in 15 minute buckets.
+//
+constexpr uint8_t kMaxTariffBuckets = 96;
+
+struct TariffCurve
+{
+    // Seconds since the epoch at which the first bucket starts.
+    //
+    uint32_t startTime = 0;
+    uint32_t bucketDuration = 0;
+    uint8_t bucketCount = 0;
+
+    // Cost per mW per second, in any unit. Keep these within +/-100000.
+    // Before the first bucket and after the last, the cost of the nearest
+    // bucket applies.
+    //
+    int32_t costs[kMaxTariffBuckets] = {};
+};
+
+// The cost of running the forecast's slots back to back from startTime.
+//
+int64_t GetForecastCost(const ForecastPlan &plan, const TariffCurve &curve, uint32_t startTime);
+
+// Finds the start time, no earlier than earliestStartTime and finishing by
+// latestEndTime, with the lowest cost. Ties go to the earliest start. Returns
+// false if the program doesn't fit in the window.
+//
+// The cost only changes slope where a slot boundary crosses a bucket boundary,
+// so only those (buckets + 1) x (slots + 1) start times are tried. Each is
+// priced slot by slot from a running sum of the curve, so the search is
+// O(buckets x slots^2), with no allocation. Forecasts have few enough slots
+// for that to stay well under a millisecond (see dishwasher_bench).
+//
+bool FindCheapestStart(const ForecastPlan &plan, const TariffCurve &curve, uint32_t earliestStartTime, uint32_t latestEndTime, uint32_t &startTime);
@@ -1,6 +1,10 @@
+#define DISHWASHER_LOG_LEVEL CONFIG_DISHWASHER_LOG_LEVEL_DISPLAY
+#include "dishwasher_log.h"
+
 #include <stdio.h>
+#include <string.h>
 #include "driver/gpio.h"
-#include "esp_log.h"
+#include "esp_timer.h"
 #include "status_display.h"
 
 #include "driver/i2c_master.h"
@@ -13,6 +17,7 @@
 #include "lvgl.h"
 
 #include "dishwasher_manager.h"
+#include "wash_programs.h"
 
 static const char *TAG = "status_display";
 
@@ -32,8 +37,24 @@ static const char *TAG = "status_display";
 #define EXAMPLE_LCD_H_RES 128
 #define EXAMPLE_LCD_V_RES 64
 
+// The SSD1306 stores eight rows of pixels per byte, in pages across the screen.
+//
+#define SSD1306_PAGE_HEIGHT 8
+#define SSD1306_PAGE_COUNT (EXAMPLE_LCD_V_RES / SSD1306_PAGE_HEIGHT)
+
+// Each draw_bitmap call sends the column and page address commands (three bytes each) ahead of the data.
+//
+#define SSD1306_ADDRESSING_BYTES 6
+
+static_assert(SSD1306_PAGE_COUNT == 8 && EXAMPLE_LCD_H_RES == 128, "StatusDisplay's copy of the panel doesn't match its size");
+
 StatusDisplay StatusDisplay::sStatusDisplay;
 
+static void FlushCallback(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_map)
+{
+    StatusDisplayMgr().Flush(drv, area, color_map);
+}
+
 esp_err_t StatusDisplay::Init()
 {
     ESP_LOGI(TAG, "StatusDisplay::Init()");
@@ -88,7 +109,7 @@ esp_err_t StatusDisplay::Init()
         .io_handle = io_handle,
         .panel_handle = mPanelHandle,
         .buffer_size = EXAMPLE_LCD_H_RES * EXAMPLE_LCD_V_RES,
-        .double_buffer = true,
+        .double_buffer = false, // The I2C transfer is synchronous, so a second buffer is never drawn into while the first is sent.
         .hres = EXAMPLE_LCD_H_RES,
         .vres = EXAMPLE_LCD_V_RES,
         .monochrome = true,
@@ -100,6 +121,16 @@ esp_err_t StatusDisplay::Init()
 
     mDisplayHandle = lvgl_port_add_disp(&disp_cfg);
 
+    // The LVGL task is already running, so everything from here on that touches
+    // LVGL holds its lock.
+    //
+    lvgl_port_lock(0);
+
+    // esp_lvgl_port sends every area LVGL redraws, which for our full width labels
+    // means whole pages. Take over the flush so only the columns that changed are sent.
+    //
+    mDisplayHandle->driver->flush_cb = FlushCallback;
+
     lv_disp_set_rotation(mDisplayHandle, LV_DISP_ROT_180);
 
     ESP_LOGI(TAG, "LVGL2");
@@ -159,7 +190,7 @@ esp_err_t StatusDisplay::Init()
 
     mMenuButtonLabel = lv_label_create(scr);
 
-    lv_label_set_text(mMenuButtonLabel, "MENU");
+    lv_label_set_text_static(mMenuButtonLabel, "MENU");
     lv_obj_set_width(mMenuButtonLabel, mDisplayHandle->driver->hor_res);
     lv_obj_set_style_text_align(mMenuButtonLabel, LV_TEXT_ALIGN_CENTER, 0);
     lv_obj_align(mMenuButtonLabel, LV_ALIGN_BOTTOM_MID, 0, 0);
@@ -189,136 +220,333 @@ esp_err_t StatusDisplay::Init()
     lv_obj_align(mEnergyManagementOptInLabel, LV_ALIGN_RIGHT_MID, 0, 0);
     lv_obj_set_style_text_align(mEnergyManagementOptInLabel, LV_TEXT_ALIGN_RIGHT, 0);
 
+    lvgl_port_unlock();
+
     ESP_LOGI(TAG, "StatusDisplay::Init() finished");
 
     return ESP_OK;
 }
 
+void StatusDisplay::Flush(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_map)
+{
+    // esp_lvgl_port rounds monochrome areas out to whole pages and renders them in
+    // the SSD1306 layout: one byte per column for each page, page after page.
+    //
+    const uint8_t *data = (const uint8_t *)color_map;
+
+    int32_t width = area->x2 - area->x1 + 1;
+    int32_t first_page = area->y1 / SSD1306_PAGE_HEIGHT;
+    int32_t last_page = area->y2 / SSD1306_PAGE_HEIGHT;
+
+    bool has_sent = false;
+
+    for (int32_t page = first_page; page <= last_page && page < SSD1306_PAGE_COUNT; page++)
+    {
+        const uint8_t *row = data + (page - first_page) * width;
+        uint8_t *panel_row = mPanelContents[page] + area->x1;
+
+        int32_t first_column = 0;
+        int32_t last_column = width - 1;
+
+        // Until the page has been sent once, we don't know what the panel holds.
+        //
+        if (mIsPanelPageKnown[page])
+        {
+            while (first_column < width && row[first_column] == panel_row[first_column])
+            {
+                first_column++;
+            }
+
+            if (first_column == width)
+            {
+                continue;
+            }
+
+            while (row[last_column] == panel_row[last_column])
+            {
+                last_column--;
+            }
+        }
+
+        int32_t length = last_column - first_column + 1;
+
+        memcpy(panel_row + first_column, row + first_column, length);
+
+        if (area->x1 == 0 && width == EXAMPLE_LCD_H_RES)
+        {
+            mIsPanelPageKnown[page] = true;
+        }
+
+        // Completing the transfer signals LVGL that the flush is done.
+        //
+        esp_lcd_panel_draw_bitmap(mPanelHandle,
+                                  area->x1 + first_column,
+                                  page * SSD1306_PAGE_HEIGHT,
+                                  area->x1 + last_column + 1,
+                                  (page + 1) * SSD1306_PAGE_HEIGHT,
+                                  row + first_column);
+
+        CountFlushedBytes(length + SSD1306_ADDRESSING_BYTES);
+        has_sent = true;
+    }
+
+    // Nothing was sent, so there is no transfer to complete it.
+    //
+    if (!has_sent)
+    {
+        lv_disp_flush_ready(drv);
+    }
+}
+
+void StatusDisplay::CountFlushedBytes(uint32_t bytes)
+{
+    int64_t now = esp_timer_get_time();
+
+    mFlushedBytes += bytes;
+
+    if (now - mFlushWindowStart >= 1000 * 1000)
+    {
+        mFlushedBytesPerSecond = mFlushedBytesInWindow;
+        mFlushedBytesInWindow = 0;
+        mFlushWindowStart = now;
+
+        ESP_LOGD(TAG, "I2C: %" PRIu32 " bytes/s, %" PRIu64 " bytes total", mFlushedBytesPerSecond, mFlushedBytes);
+    }
+
+    mFlushedBytesInWindow += bytes;
+}
+
+uint64_t StatusDisplay::GetFlushedBytes()
+{
+    return mFlushedBytes;
+}
+
+uint32_t StatusDisplay::GetFlushedBytesPerSecond()
+{
+    return mFlushedBytesPerSecond;
+}
+
 void StatusDisplay::TurnOn()
 {
     ESP_LOGI(TAG, "Turning display on");
     esp_lcd_panel_disp_on_off(mPanelHandle, true);
+    lvgl_port_resume();
 }
 
+// The panel keeps its memory while it is off, so mPanelContents stays valid.
+// Stopping the port also stops LVGL's tick timer, which would otherwise wake
+// the chip every few milliseconds.
+//
 void StatusDisplay::TurnOff()
 {
     ESP_LOGI(TAG, "Turning display off");
+    lvgl_port_stop();
     esp_lcd_panel_disp_on_off(mPanelHandle, false);
 }
 
-void StatusDisplay::UpdateDisplay(bool showingMenu, bool hasOptedIn, bool isProgramSelected, int32_t startsIn, const char *state_text, const char *mode_text, const char *status_text)
+static const char *GetStateText(State state)
 {
-    ESP_LOGI(TAG, "Updating the display");
+    switch (state)
+    {
+    case RUNNING:
+        return "RUNNING";
+    case PAUSED:
+        return "PAUSED";
+    case STOPPED:
+        return "STOPPED";
+    default:
+        return "";
+    }
+}
 
-    ESP_LOGI(TAG, "showingMenu: [%d]", showingMenu);
-    ESP_LOGI(TAG, "hasOptedIn: [%d]", hasOptedIn);
-    ESP_LOGI(TAG, "isProgramSelected: [%d]", isProgramSelected);
-    ESP_LOGI(TAG, "startsIn: [%lu]", startsIn);
-    ESP_LOGI(TAG, "state_text: [%s]", state_text);
-    ESP_LOGI(TAG, "mode_text: [%s]", mode_text);
-    ESP_LOGI(TAG, "status_text: [%s]", status_text);
+// LVGL invalidates an object, and so redraws and flushes its area, on every
+// call that touches it. These helpers compare against what the object already
+// shows and skip the call when nothing would change.
+//
+static void SetHidden(lv_obj_t *obj, bool hidden)
+{
+    if (lv_obj_has_flag(obj, LV_OBJ_FLAG_HIDDEN) == hidden)
+    {
+        return;
+    }
 
-    if (showingMenu)
+    if (hidden)
     {
-        ESP_LOGI(TAG, "Showing the menu: hasOptedIn=%d", hasOptedIn);
+        lv_obj_add_flag(obj, LV_OBJ_FLAG_HIDDEN);
+    }
+    else
+    {
+        lv_obj_clear_flag(obj, LV_OBJ_FLAG_HIDDEN);
+    }
+}
 
-        lv_label_set_text(mMenuButtonLabel, "EXIT");
-        lv_obj_clear_flag(mMenuHeaderLabel, LV_OBJ_FLAG_HIDDEN);
+// For text that never changes, like string literals and the program labels.
+// LVGL keeps the pointer, so comparing pointers is enough.
+//
+static void SetStaticText(lv_obj_t *obj, const char *text)
+{
+    if (lv_label_get_text(obj) == text)
+    {
+        return;
+    }
 
-        if (hasOptedIn)
-        {
-            // Remove background from Opt Out
-            lv_obj_set_style_bg_color(mEnergyManagementOptOutLabel, lv_color_hex(0xffffff), LV_PART_MAIN);
-            lv_obj_set_style_bg_opa(mEnergyManagementOptOutLabel, LV_OPA_COVER, LV_PART_MAIN);
-            lv_obj_set_style_text_color(mEnergyManagementOptOutLabel, lv_color_hex(0x000000), LV_PART_MAIN);
-
-            lv_obj_set_style_bg_color(mEnergyManagementOptInLabel, lv_color_hex(0x000000), LV_PART_MAIN);
-            lv_obj_set_style_bg_opa(mEnergyManagementOptInLabel, LV_OPA_COVER, LV_PART_MAIN);
-            lv_obj_set_style_text_color(mEnergyManagementOptInLabel, lv_color_hex(0xffffff), LV_PART_MAIN);
-        }
-        else
-        {
-            // Remove background from Opt In
-            lv_obj_set_style_bg_color(mEnergyManagementOptInLabel, lv_color_hex(0xffffff), LV_PART_MAIN);
-            lv_obj_set_style_bg_opa(mEnergyManagementOptInLabel, LV_OPA_COVER, LV_PART_MAIN);
-            lv_obj_set_style_text_color(mEnergyManagementOptInLabel, lv_color_hex(0x000000), LV_PART_MAIN);
-
-            lv_obj_set_style_bg_color(mEnergyManagementOptOutLabel, lv_color_hex(0x000000), LV_PART_MAIN);
-            lv_obj_set_style_bg_opa(mEnergyManagementOptOutLabel, LV_OPA_COVER, LV_PART_MAIN);
-            lv_obj_set_style_text_color(mEnergyManagementOptOutLabel, lv_color_hex(0xffffff), LV_PART_MAIN);
-        }
+    lv_label_set_text_static(obj, text);
+}
 
-        lv_obj_clear_flag(mEnergyManagementOptOutLabel, LV_OBJ_FLAG_HIDDEN);
-        lv_obj_clear_flag(mEnergyManagementOptInLabel, LV_OBJ_FLAG_HIDDEN);
+// For text formatted at runtime. The label shows buffer as static text, so
+// buffer is only overwritten when the text really differs.
+//
+static void SetBufferedText(lv_obj_t *obj, char *buffer, size_t size, const char *text)
+{
+    if (lv_label_get_text(obj) == buffer && strcmp(buffer, text) == 0)
+    {
+        return;
+    }
+
+    snprintf(buffer, size, "%s", text);
+    lv_label_set_text_static(obj, buffer);
+}
 
-        lv_obj_add_flag(mStateLabel, LV_OBJ_FLAG_HIDDEN);
-        lv_obj_add_flag(mModeLabel, LV_OBJ_FLAG_HIDDEN);
-        lv_obj_add_flag(mStatusLabel, LV_OBJ_FLAG_HIDDEN);
-        lv_obj_add_flag(mStartsInLabel, LV_OBJ_FLAG_HIDDEN);
+void StatusDisplay::UpdateDisplay(const StatusViewModel &view)
+{
+    ESP_LOGV(TAG, "UpdateDisplay: menu=%d optedIn=%d selected=%d startsIn=%" PRIu32 " state=%d mode=%d phase=%d remaining=%" PRIu32,
+             view.isShowingMenu, view.hasOptedIn, view.isProgramSelected, view.startsIn, view.state, view.mode, view.hasPhase ? view.phase : -1, view.timeRemaining);
+
+    // Nothing to do if the screen already shows this.
+    //
+    if (mHasLastView && view == mLastView)
+    {
+        return;
     }
-    else
+
+    mLastView = view;
+    mHasLastView = true;
+
+    // The LVGL task renders the same labels, and reads the text buffers.
+    //
+    lvgl_port_lock(0);
+    ShowView(view);
+    lvgl_port_unlock();
+}
+
+// Called with the LVGL lock held.
+//
+void StatusDisplay::ShowView(const StatusViewModel &view)
+{
+    if (view.isShowingMenu)
     {
-        // The standard screen (menu closed)
-        //
-        lv_label_set_text(mMenuButtonLabel, "MENU");
-        lv_obj_clear_flag(mMenuButtonLabel, LV_OBJ_FLAG_HIDDEN);
+        ESP_LOGD(TAG, "Showing the menu: hasOptedIn=%d", view.hasOptedIn);
 
-        lv_obj_add_flag(mMenuHeaderLabel, LV_OBJ_FLAG_HIDDEN);
-        lv_obj_add_flag(mEnergyManagementOptOutLabel, LV_OBJ_FLAG_HIDDEN);
-        lv_obj_add_flag(mEnergyManagementOptInLabel, LV_OBJ_FLAG_HIDDEN);
+        SetStaticText(mMenuButtonLabel, "EXIT");
+        SetHidden(mMenuHeaderLabel, false);
 
-        if (isProgramSelected)
+        if (!mIsMenuHighlightSet || mIsOptInHighlighted != view.hasOptedIn)
         {
-            // If there a delayed start?
-            //
-            if (startsIn > 0)
+            if (view.hasOptedIn)
             {
-                lv_label_set_text(mMenuButtonLabel, "CANCEL");
-                lv_obj_clear_flag(mMenuButtonLabel, LV_OBJ_FLAG_HIDDEN);
-    
-                lv_obj_add_flag(mStateLabel, LV_OBJ_FLAG_HIDDEN);
-                lv_obj_add_flag(mModeLabel, LV_OBJ_FLAG_HIDDEN);
-                lv_obj_add_flag(mStatusLabel, LV_OBJ_FLAG_HIDDEN);
-
-                char *starts_in_formatted_buffer = (char *)malloc(128);
-                snprintf(starts_in_formatted_buffer, 128, "Starting in %lus", startsIn);
-
-                lv_label_set_text(mStartsInLabel, starts_in_formatted_buffer);
-                lv_obj_clear_flag(mStartsInLabel, LV_OBJ_FLAG_HIDDEN);
+                // Remove background from Opt Out
+                lv_obj_set_style_bg_color(mEnergyManagementOptOutLabel, lv_color_hex(0xffffff), LV_PART_MAIN);
+                lv_obj_set_style_bg_opa(mEnergyManagementOptOutLabel, LV_OPA_COVER, LV_PART_MAIN);
+                lv_obj_set_style_text_color(mEnergyManagementOptOutLabel, lv_color_hex(0x000000), LV_PART_MAIN);
+
+                lv_obj_set_style_bg_color(mEnergyManagementOptInLabel, lv_color_hex(0x000000), LV_PART_MAIN);
+                lv_obj_set_style_bg_opa(mEnergyManagementOptInLabel, LV_OPA_COVER, LV_PART_MAIN);
+                lv_obj_set_style_text_color(mEnergyManagementOptInLabel, lv_color_hex(0xffffff), LV_PART_MAIN);
             }
             else
             {
-                lv_obj_add_flag(mMenuButtonLabel, LV_OBJ_FLAG_HIDDEN);
-                lv_obj_add_flag(mStartsInLabel, LV_OBJ_FLAG_HIDDEN);
+                // Remove background from Opt In
+                lv_obj_set_style_bg_color(mEnergyManagementOptInLabel, lv_color_hex(0xffffff), LV_PART_MAIN);
+                lv_obj_set_style_bg_opa(mEnergyManagementOptInLabel, LV_OPA_COVER, LV_PART_MAIN);
+                lv_obj_set_style_text_color(mEnergyManagementOptInLabel, lv_color_hex(0x000000), LV_PART_MAIN);
+
+                lv_obj_set_style_bg_color(mEnergyManagementOptOutLabel, lv_color_hex(0x000000), LV_PART_MAIN);
+                lv_obj_set_style_bg_opa(mEnergyManagementOptOutLabel, LV_OPA_COVER, LV_PART_MAIN);
+                lv_obj_set_style_text_color(mEnergyManagementOptOutLabel, lv_color_hex(0xffffff), LV_PART_MAIN);
+            }
 
-                lv_obj_clear_flag(mStateLabel, LV_OBJ_FLAG_HIDDEN);
-                lv_obj_clear_flag(mModeLabel, LV_OBJ_FLAG_HIDDEN);
-                lv_obj_clear_flag(mStatusLabel, LV_OBJ_FLAG_HIDDEN);
+            mIsMenuHighlightSet = true;
+            mIsOptInHighlighted = view.hasOptedIn;
+        }
 
-                lv_label_set_text(mStateLabel, state_text);
-                lv_label_set_text(mModeLabel, mode_text);
-                lv_label_set_text(mStatusLabel, status_text);
-            }
+        SetHidden(mEnergyManagementOptOutLabel, false);
+        SetHidden(mEnergyManagementOptInLabel, false);
+
+        SetHidden(mStateLabel, true);
+        SetHidden(mModeLabel, true);
+        SetHidden(mStatusLabel, true);
+        SetHidden(mStartsInLabel, true);
+        return;
+    }
+
+    // The standard screen (menu closed)
+    //
+    SetHidden(mMenuHeaderLabel, true);
+    SetHidden(mEnergyManagementOptOutLabel, true);
+    SetHidden(mEnergyManagementOptInLabel, true);
+
+    // If there a delayed start?
+    //
+    if (view.isProgramSelected && view.startsIn > 0)
+    {
+        SetStaticText(mMenuButtonLabel, "CANCEL");
+        SetHidden(mMenuButtonLabel, false);
+
+        SetHidden(mStateLabel, true);
+        SetHidden(mModeLabel, true);
+        SetHidden(mStatusLabel, true);
+
+        char starts_in_text[sizeof(mStartsInText)];
+        snprintf(starts_in_text, sizeof(starts_in_text), "Starting in %" PRIu32 "s", view.startsIn);
+
+        SetBufferedText(mStartsInLabel, mStartsInText, sizeof(mStartsInText), starts_in_text);
+        SetHidden(mStartsInLabel, false);
+        return;
+    }
+
+    if (view.isProgramSelected)
+    {
+        SetHidden(mMenuButtonLabel, true);
+    }
+    else
+    {
+        SetStaticText(mMenuButtonLabel, "MENU");
+        SetHidden(mMenuButtonLabel, false);
+    }
+
+    SetHidden(mStartsInLabel, true);
+
+    SetHidden(mStateLabel, false);
+    SetHidden(mModeLabel, false);
+    SetHidden(mStatusLabel, false);
+
+    char status_text[sizeof(mStatusText)] = "";
+
+    if (view.hasPhase && view.phase < kWashPhaseCount)
+    {
+        if (view.timeRemaining > 0)
+        {
+            snprintf(status_text, sizeof(status_text), "%" PRIu32 "s (%s)", view.timeRemaining, kWashPhaseNames[view.phase]);
         }
         else
         {
-            lv_obj_clear_flag(mStateLabel, LV_OBJ_FLAG_HIDDEN);
-            lv_obj_clear_flag(mModeLabel, LV_OBJ_FLAG_HIDDEN);
-            lv_obj_clear_flag(mStatusLabel, LV_OBJ_FLAG_HIDDEN);
-
-            lv_obj_add_flag(mStartsInLabel, LV_OBJ_FLAG_HIDDEN);
-
-            lv_label_set_text(mStateLabel, state_text);
-            lv_label_set_text(mModeLabel, mode_text);
-            lv_label_set_text(mStatusLabel, status_text);
+            snprintf(status_text, sizeof(status_text), " (%s)", kWashPhaseNames[view.phase]);
         }
     }
+
+    SetStaticText(mStateLabel, GetStateText(view.state));
+    SetStaticText(mModeLabel, GetWashProgram(view.mode).label);
+    SetBufferedText(mStatusLabel, mStatusText, sizeof(mStatusText), status_text);
 }
 
 void StatusDisplay::ShowResetOptions()
 {
     ESP_LOGI(TAG, "Show reset options");
 
+    mHasLastView = false;
+
+    lvgl_port_lock(0);
+
     lv_obj_add_flag(mStateLabel, LV_OBJ_FLAG_HIDDEN);
     lv_obj_add_flag(mModeLabel, LV_OBJ_FLAG_HIDDEN);
     lv_obj_add_flag(mStatusLabel, LV_OBJ_FLAG_HIDDEN);
@@ -327,12 +555,20 @@ void StatusDisplay::ShowResetOptions()
     lv_obj_clear_flag(mResetMessageLabel, LV_OBJ_FLAG_HIDDEN);
     lv_obj_clear_flag(mYesButtonLabel, LV_OBJ_FLAG_HIDDEN);
     lv_obj_clear_flag(mNoButtonLabel, LV_OBJ_FLAG_HIDDEN);
+
+    lvgl_port_unlock();
 }
 
 void StatusDisplay::HideResetOptions()
 {
     ESP_LOGI(TAG, "Hide reset options");
 
+    // The next update has to put back whatever this changes.
+    //
+    mHasLastView = false;
+
+    lvgl_port_lock(0);
+
     lv_obj_clear_flag(mStateLabel, LV_OBJ_FLAG_HIDDEN);
     lv_obj_clear_flag(mModeLabel, LV_OBJ_FLAG_HIDDEN);
     lv_obj_clear_flag(mStatusLabel, LV_OBJ_FLAG_HIDDEN);
@@ -341,4 +577,6 @@ void StatusDisplay::HideResetOptions()
     lv_obj_add_flag(mResetMessageLabel, LV_OBJ_FLAG_HIDDEN);
     lv_obj_add_flag(mYesButtonLabel, LV_OBJ_FLAG_HIDDEN);
     lv_obj_add_flag(mNoButtonLabel, LV_OBJ_FLAG_HIDDEN);
+
+    lvgl_port_unlock();
 }
\ No newline at end of file
@@ -10,9 +10,35 @@
 enum State {
   STOPPED,
   RUNNING,
-  PAUSED
+  PAUSED,
+  ERROR
 }; 
 
+// Everything the status screen shows, as plain values.
+//
+// The display formats these into its own buffers, so an update never touches
+// the heap.
+//
+struct StatusViewModel
+{
+    bool isShowingMenu;
+    bool hasOptedIn;
+    bool isProgramSelected;
+    uint32_t startsIn;      // Seconds until a delayed start begins, 0 if there isn't one.
+    State state;
+    uint8_t mode;           // Index into kWashPrograms.
+    bool hasPhase;
+    uint8_t phase;          // Index into kWashPhaseNames, if hasPhase is set.
+    uint32_t timeRemaining; // Seconds left in the running program.
+
+    bool operator==(const StatusViewModel &other) const
+    {
+        return isShowingMenu == other.isShowingMenu && hasOptedIn == other.hasOptedIn && isProgramSelected == other.isProgramSelected &&
+               startsIn == other.startsIn && state == other.state && mode == other.mode && hasPhase == other.hasPhase &&
+               phase == other.phase && timeRemaining == other.timeRemaining;
+    }
+};
+
 class StatusDisplay
 {
 public:
@@ -21,14 +47,26 @@ public:
     void TurnOn();
     void TurnOff();
 
-    void UpdateDisplay(bool showingMenu, bool hasOptedIn, bool programSelected, int32_t startsIn, const char *state_text, const char *mode_text, const char *status_text);
+    void UpdateDisplay(const StatusViewModel &view);
 
     void ShowResetOptions();
     void HideResetOptions();
 
+    // Called by LVGL to send a redrawn area to the panel.
+    //
+    void Flush(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_map);
+
+    // Bytes sent to the panel over I2C, in total and during the last full second.
+    //
+    uint64_t GetFlushedBytes();
+    uint32_t GetFlushedBytesPerSecond();
+
 private:
     friend StatusDisplay & StatusDisplayMgr(void);
     static StatusDisplay sStatusDisplay;
+
+    void ShowView(const StatusViewModel &view);
+
     lv_disp_t *mDisplayHandle;
     esp_lcd_panel_handle_t mPanelHandle;
 
@@ -43,6 +81,33 @@ private:
     lv_obj_t *mMenuHeaderLabel;
     lv_obj_t *mEnergyManagementOptOutLabel;
     lv_obj_t *mEnergyManagementOptInLabel;
+
+    // The labels showing these use them as static text, so they must outlive every update.
+    //
+    char mStartsInText[32];
+    char mStatusText[48];
+
+    // What the screen currently shows, so that updates only touch what changed.
+    //
+    StatusViewModel mLastView;
+    bool mHasLastView = false;
+    bool mIsMenuHighlightSet = false;
+    bool mIsOptInHighlighted = false;
+
+    void CountFlushedBytes(uint32_t bytes);
+
+    // A copy of the panel's memory (128 columns by 8 pages), so a flush only sends the columns that differ.
+    //
+    static constexpr int kPanelColumns = 128;
+    static constexpr int kPanelPages = 8;
+
+    uint8_t mPanelContents[kPanelPages][kPanelColumns];
+    bool mIsPanelPageKnown[kPanelPages] = {};
+
+    uint64_t mFlushedBytes = 0;
+    uint32_t mFlushedBytesInWindow = 0;
+    uint32_t mFlushedBytesPerSecond = 0;
+    int64_t mFlushWindowStart = 0;
 };
 
 inline StatusDisplay & StatusDisplayMgr(void)
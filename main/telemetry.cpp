@@ -0,0 +1,156 @@
+#define DISHWASHER_LOG_LEVEL CONFIG_DISHWASHER_LOG_LEVEL_PROGRAM
+#include "dishwasher_log.h"
+
+#include "telemetry.h"
+
+#include <esp_heap_caps.h>
+#include <string.h>
+
+static const char *TAG = "telemetry";
+
+Telemetry Telemetry::sTelemetry;
+
+esp_err_t Telemetry::Init()
+{
+    ESP_LOGI(TAG, "Initializing Telemetry");
+
+    // The tasks the firmware doesn't create itself, but whose stacks are set in
+    // menuconfig and carry its work: Matter, the esp_timer callbacks and the
+    // console commands.
+    //
+    WatchTask("CHIP", CONFIG_CHIP_TASK_STACK_SIZE);
+    WatchTask("esp_timer", CONFIG_ESP_TIMER_TASK_STACK_SIZE);
+#if CONFIG_ENABLE_CHIP_SHELL
+    WatchTask("matter_console", CONFIG_ESP_MATTER_CONSOLE_TASK_STACK);
+#endif
+
+    Sample();
+
+#if CONFIG_DISHWASHER_TELEMETRY_INTERVAL > 0
+    const esp_timer_create_args_t sample_timer_args = {
+        .callback = &SampleTimerCallback,
+        .arg = this,
+        .name = "telemetry",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&sample_timer_args, &mSampleTimer));
+    ESP_ERROR_CHECK(esp_timer_start_periodic(mSampleTimer, (uint64_t)CONFIG_DISHWASHER_TELEMETRY_INTERVAL * 1000000));
+#else
+    ESP_LOGI(TAG, "Periodic sampling is disabled, samples are only taken on request");
+#endif
+
+    return ESP_OK;
+}
+
+void Telemetry::SampleTimerCallback(void *arg)
+{
+    ((Telemetry *)arg)->Sample();
+}
+
+void Telemetry::WatchTask(const char *name, uint32_t stack_size)
+{
+    taskENTER_CRITICAL(&mLock);
+
+    if (mTaskCount < kMaxTelemetryTasks)
+    {
+        mTasks[mTaskCount++] = {
+            .name = name,
+            .stackSize = stack_size,
+            .handle = nullptr,
+        };
+    }
+
+    taskEXIT_CRITICAL(&mLock);
+}
+
+void Telemetry::Sample()
+{
+    TelemetrySample sample = {};
+    WatchedTask tasks[kMaxTelemetryTasks];
+    uint8_t task_count;
+
+    // The lookups can't be made inside the critical section, so work on a copy
+    // of the task list and save any handles found afterwards. Watched tasks
+    // never exit, so a handle stays good once found.
+    //
+    taskENTER_CRITICAL(&mLock);
+    memcpy(tasks, mTasks, sizeof(tasks));
+    task_count = mTaskCount;
+    taskEXIT_CRITICAL(&mLock);
+
+    sample.uptime = esp_timer_get_time() / 1000000;
+    sample.freeHeap = heap_caps_get_free_size(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    sample.largestFreeBlock = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    sample.minimumFreeHeap = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+
+    for (uint8_t i = 0; i < task_count; i++)
+    {
+        if (tasks[i].handle == nullptr)
+        {
+            tasks[i].handle = xTaskGetHandle(tasks[i].name);
+        }
+
+        if (tasks[i].handle != nullptr)
+        {
+            sample.stackHighWater[i] = uxTaskGetStackHighWaterMark(tasks[i].handle);
+        }
+    }
+
+    taskENTER_CRITICAL(&mLock);
+
+    for (uint8_t i = 0; i < task_count; i++)
+    {
+        mTasks[i].handle = tasks[i].handle;
+    }
+
+    mSamples[mNextSample] = sample;
+    mNextSample = (mNextSample + 1) % kTelemetrySampleCount;
+
+    if (mSampleCount < kTelemetrySampleCount)
+    {
+        mSampleCount++;
+    }
+
+    taskEXIT_CRITICAL(&mLock);
+
+    ESP_LOGD(TAG, "Heap free %lu, largest block %lu, minimum free %lu", sample.freeHeap, sample.largestFreeBlock, sample.minimumFreeHeap);
+}
+
+uint8_t Telemetry::GetSampleCount()
+{
+    taskENTER_CRITICAL(&mLock);
+    uint8_t count = mSampleCount;
+    taskEXIT_CRITICAL(&mLock);
+
+    return count;
+}
+
+TelemetrySample Telemetry::GetSample(uint8_t index)
+{
+    taskENTER_CRITICAL(&mLock);
+    uint8_t oldest = (mNextSample + kTelemetrySampleCount - mSampleCount) % kTelemetrySampleCount;
+    TelemetrySample sample = mSamples[(oldest + index) % kTelemetrySampleCount];
+    taskEXIT_CRITICAL(&mLock);
+
+    return sample;
+}
+
+uint8_t Telemetry::GetTaskCount()
+{
+    taskENTER_CRITICAL(&mLock);
+    uint8_t count = mTaskCount;
+    taskEXIT_CRITICAL(&mLock);
+
+    return count;
+}
+
+// Task names and sizes never change once watched.
+//
+const char *Telemetry::GetTaskName(uint8_t index)
+{
+    return mTasks[index].name;
+}
+
+uint32_t Telemetry::GetTaskStackSize(uint8_t index)
+{
+    return mTasks[index].stackSize;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <esp_err.h>
+#include <esp_timer.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <inttypes.h>
+
+constexpr uint8_t kMaxTelemetryTasks = 8;
+constexpr uint8_t kTelemetrySampleCount = 16;
+
+// The free memory at one moment. The heap figures are for internal RAM.
+//
+struct TelemetrySample
+{
+    uint32_t uptime;
+    uint32_t freeHeap;
+    uint32_t largestFreeBlock;
+    uint32_t minimumFreeHeap;
+
+    // Bytes of each watched task's stack that have never been used, in the
+    // order the tasks were watched. 0 until the task exists.
+    //
+    uint32_t stackHighWater[kMaxTelemetryTasks];
+};
+
+// Samples the heap and the stacks of the watched tasks every
+// DISHWASHER_TELEMETRY_INTERVAL seconds, keeping the last kTelemetrySampleCount
+// samples, so stack sizes and buffers can be tuned from what the device
+// actually used. `matter esp dishwasher stats` prints them.
+//
+// Sampling runs on the esp_timer task, and the Get* methods may be called from
+// any task.
+//
+class Telemetry
+{
+public:
+    esp_err_t Init();
+
+    // Adds a task to sample, by the name it was created with. Tasks that start
+    // later, such as the Matter task, are found when they first show up.
+    //
+    void WatchTask(const char *name, uint32_t stack_size);
+
+    // Takes a sample now, on top of the timer's.
+    //
+    void Sample();
+
+    uint8_t GetSampleCount();
+
+    // Sample 0 is the oldest still kept.
+    //
+    TelemetrySample GetSample(uint8_t index);
+
+    uint8_t GetTaskCount();
+    const char *GetTaskName(uint8_t index);
+    uint32_t GetTaskStackSize(uint8_t index);
+
+private:
+    friend Telemetry &TelemetryMgr(void);
+
+    static Telemetry sTelemetry;
+
+    static void SampleTimerCallback(void *arg);
+
+    struct WatchedTask
+    {
+        const char *name;
+        uint32_t stackSize;
+        TaskHandle_t handle;
+    };
+
+    // Guards everything below, as the timer and the console both sample.
+    //
+    portMUX_TYPE mLock = portMUX_INITIALIZER_UNLOCKED;
+
+    esp_timer_handle_t mSampleTimer = nullptr;
+
+    WatchedTask mTasks[kMaxTelemetryTasks] = {};
+    uint8_t mTaskCount = 0;
+
+    TelemetrySample mSamples[kTelemetrySampleCount] = {};
+    uint8_t mNextSample = 0;
+    uint8_t mSampleCount = 0;
+};
+
+inline Telemetry &TelemetryMgr(void)
+{
+    return Telemetry::sTelemetry;
+}
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The wash programs offered by the dishwasher.
+//
+// Everything that depends on a program (the DishwasherMode options, the
+// OperationalState phase list, the energy forecast and the program timings)
+// is generated from this table, so adding a program is a one-line change.
+//
+
+// Phases, in the order they are reported through OperationalState.
+//
+enum class WashPhase : uint8_t
+{
+    kPreSoak,
+    kMainWash,
+    kRinse,
+    kFinalRinse,
+    kDrying,
+};
+
+constexpr uint8_t kWashPhaseCount = 5;
+
+constexpr const char *kWashPhaseNames[kWashPhaseCount] = {"pre-soak", "main-wash", "rinse", "final-rinse", "drying"};
+
+// One step of a program. Durations are in seconds and power in mW, matching
+// the units used by the DeviceEnergyManagement forecast slots.
+//
+struct WashStep
+{
+    WashPhase phase;
+    uint32_t duration;
+    int64_t nominalPower;
+    int64_t minPower;
+    int64_t maxPower;
+    bool isPausable;
+};
+
+constexpr uint8_t kMaxWashSteps = 5;
+
+struct WashProgram
+{
+    const char *label;
+    uint8_t stepCount;
+    WashStep steps[kMaxWashSteps];
+
+    constexpr uint32_t GetDuration() const
+    {
+        uint32_t duration = 0;
+
+        for (uint8_t i = 0; i < stepCount; i++)
+        {
+            duration += steps[i].duration;
+        }
+
+        return duration;
+    }
+};
+
+constexpr uint32_t Minutes(uint32_t minutes)
+{
+    return minutes * 60;
+}
+
+constexpr int64_t Watts(int64_t watts)
+{
+    return watts * 1000;
+}
+
+// How long an energy manager may pause a pausable step. Much longer than this
+// and the water in the machine goes cold.
+//
+constexpr uint32_t kMinPauseDuration = Minutes(1);
+constexpr uint32_t kMaxPauseDuration = Minutes(30);
+
+// These are the modes on my dishwasher. The mode value is the index into this
+// table, so Eco, Chef and Quick keep the values they have always had.
+//
+constexpr WashProgram kWashPrograms[] = {
+    {"Eco 50°", 5, {
+        {WashPhase::kPreSoak, Minutes(15), Watts(100), Watts(80), Watts(150), true},
+        {WashPhase::kMainWash, Minutes(60), Watts(1000), Watts(600), Watts(1800), true},
+        {WashPhase::kRinse, Minutes(20), Watts(150), Watts(80), Watts(150), true},
+        {WashPhase::kFinalRinse, Minutes(30), Watts(1200), Watts(800), Watts(1800), false},
+        {WashPhase::kDrying, Minutes(55), Watts(50), Watts(30), Watts(100), true},
+    }},
+    {"Chef 70°", 5, {
+        {WashPhase::kPreSoak, Minutes(10), Watts(100), Watts(80), Watts(150), true},
+        {WashPhase::kMainWash, Minutes(50), Watts(2000), Watts(1500), Watts(2200), true},
+        {WashPhase::kRinse, Minutes(15), Watts(150), Watts(80), Watts(150), true},
+        {WashPhase::kFinalRinse, Minutes(25), Watts(2000), Watts(1500), Watts(2200), false},
+        {WashPhase::kDrying, Minutes(40), Watts(50), Watts(30), Watts(100), true},
+    }},
+    {"Quick 45°", 3, {
+        {WashPhase::kMainWash, Minutes(20), Watts(1800), Watts(1500), Watts(2200), false},
+        {WashPhase::kRinse, Minutes(5), Watts(150), Watts(80), Watts(150), false},
+        {WashPhase::kFinalRinse, Minutes(10), Watts(1800), Watts(1500), Watts(2200), false},
+    }},
+    {"Auto 45° - 65°", 5, {
+        {WashPhase::kPreSoak, Minutes(10), Watts(100), Watts(80), Watts(150), true},
+        {WashPhase::kMainWash, Minutes(55), Watts(1500), Watts(1000), Watts(2200), true},
+        {WashPhase::kRinse, Minutes(15), Watts(150), Watts(80), Watts(150), true},
+        {WashPhase::kFinalRinse, Minutes(25), Watts(1600), Watts(1000), Watts(2200), false},
+        {WashPhase::kDrying, Minutes(45), Watts(50), Watts(30), Watts(100), true},
+    }},
+    {"Glass 40°", 4, {
+        {WashPhase::kMainWash, Minutes(30), Watts(800), Watts(600), Watts(1200), true},
+        {WashPhase::kRinse, Minutes(15), Watts(150), Watts(80), Watts(150), true},
+        {WashPhase::kFinalRinse, Minutes(20), Watts(900), Watts(600), Watts(1200), false},
+        {WashPhase::kDrying, Minutes(30), Watts(50), Watts(30), Watts(100), true},
+    }},
+    {"Silence 50°", 5, {
+        {WashPhase::kPreSoak, Minutes(20), Watts(80), Watts(60), Watts(100), true},
+        {WashPhase::kMainWash, Minutes(90), Watts(700), Watts(500), Watts(1200), true},
+        {WashPhase::kRinse, Minutes(25), Watts(100), Watts(60), Watts(100), true},
+        {WashPhase::kFinalRinse, Minutes(35), Watts(900), Watts(600), Watts(1200), false},
+        {WashPhase::kDrying, Minutes(60), Watts(50), Watts(30), Watts(100), true},
+    }},
+    {"Pre Rinse", 1, {
+        {WashPhase::kPreSoak, Minutes(15), Watts(100), Watts(80), Watts(150), true},
+    }},
+    {"Short 60°", 4, {
+        {WashPhase::kMainWash, Minutes(35), Watts(2000), Watts(1500), Watts(2200), false},
+        {WashPhase::kRinse, Minutes(10), Watts(150), Watts(80), Watts(150), false},
+        {WashPhase::kFinalRinse, Minutes(15), Watts(2000), Watts(1500), Watts(2200), false},
+        {WashPhase::kDrying, Minutes(20), Watts(50), Watts(30), Watts(100), true},
+    }},
+    {"Machine Care", 4, {
+        {WashPhase::kPreSoak, Minutes(10), Watts(100), Watts(80), Watts(150), true},
+        {WashPhase::kMainWash, Minutes(60), Watts(2200), Watts(2000), Watts(2200), false},
+        {WashPhase::kRinse, Minutes(15), Watts(150), Watts(80), Watts(150), true},
+        {WashPhase::kFinalRinse, Minutes(25), Watts(2200), Watts(2000), Watts(2200), false},
+    }},
+};
+
+constexpr uint8_t kWashProgramCount = sizeof(kWashPrograms) / sizeof(kWashPrograms[0]);
+
+constexpr bool IsValidWashProgramTable()
+{
+    for (const WashProgram &program : kWashPrograms)
+    {
+        if (program.stepCount == 0 || program.stepCount > kMaxWashSteps)
+        {
+            return false;
+        }
+
+        for (uint8_t i = 0; i < program.stepCount; i++)
+        {
+            const WashStep &step = program.steps[i];
+
+            if (step.duration == 0 || step.minPower <= 0 || step.minPower > step.nominalPower || step.nominalPower > step.maxPower)
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+static_assert(IsValidWashProgramTable(), "kWashPrograms contains an invalid step");
+
+inline const WashProgram &GetWashProgram(uint8_t mode)
+{
+    return kWashPrograms[mode < kWashProgramCount ? mode : 0];
+}
+
+// The most any step of any program can draw, reported as the ESA's AbsMaxPower.
+//
+constexpr int64_t GetWashProgramsMaxPower()
+{
+    int64_t max_power = 0;
+
+    for (const WashProgram &program : kWashPrograms)
+    {
+        for (uint8_t i = 0; i < program.stepCount; i++)
+        {
+            if (program.steps[i].maxPower > max_power)
+            {
+                max_power = program.steps[i].maxPower;
+            }
+        }
+    }
+
+    return max_power;
+}